@@ -0,0 +1,67 @@
+// Counts every heap allocation of the process, including the ones made
+// inside cairo, pango & glib, by interposing the allocator. The real
+// implementation is reached through glibc's internal entry points.
+#include "alloc.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+static atomic_int counting;
+static atomic_ulong count;
+static atomic_ulong bytes;
+
+static void record(size_t size) {
+	if (atomic_load_explicit(&counting, memory_order_relaxed)) {
+		atomic_fetch_add_explicit(&count, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&bytes, size, memory_order_relaxed);
+	}
+}
+
+void *malloc(size_t size) {
+	record(size);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	record(nmemb * size);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	record(size);
+	return __libc_realloc(ptr, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	record(size);
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	record(size);
+	*ptr = __libc_memalign(alignment, size);
+	return *ptr ? 0 : ENOMEM;
+}
+
+void free(void *ptr) {
+	__libc_free(ptr);
+}
+
+void alloc_start(void) {
+	atomic_store(&count, 0);
+	atomic_store(&bytes, 0);
+	atomic_store(&counting, 1);
+}
+
+void alloc_stop(struct alloc_stats *stats) {
+	atomic_store(&counting, 0);
+	stats->count = atomic_load(&count);
+	stats->bytes = atomic_load(&bytes);
+}
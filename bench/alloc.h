@@ -0,0 +1,11 @@
+#pragma once
+
+struct alloc_stats {
+	unsigned long count;
+	unsigned long bytes;
+};
+
+// counts allocations made by any thread until alloc_stop()
+void alloc_start(void);
+
+void alloc_stop(struct alloc_stats *stats);
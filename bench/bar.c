@@ -0,0 +1,274 @@
+// Renders the status bar into image surfaces, outside of a session, and
+// reports how long a frame takes and how much it allocates. The fake
+// monitor below draws through drwl_draw_bar(), like renderbar() in dwl.c.
+//
+// usage: bench/bar [-n frames] [-p] [-f font]... [-s scale]... [-w width]...
+#include "../stext.h"
+#include "alloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LENGTH(X) (sizeof(X) / sizeof((X)[0]))
+#define MAX_ARGS (8)
+
+enum workload {
+	// nothing changed since the last frame
+	LoadIdle,
+	// only the date ticked, the common case
+	LoadClock,
+	// every segment changed
+	LoadFull,
+	LoadLast
+};
+
+static const char *workload_names[] = { "idle", "clock", "full" };
+
+// same as the defaults in config.def.h
+static const uint32_t colors[][2] = {
+	{ 0xebdbb2ff, 0x181716ff },
+	{ 0xfbf1c7ff, 0x3c3836ff },
+};
+
+static char *tags[] = { "1", "2", "3", "4", "5" };
+
+static const char *titles[] = {
+	"foot: ~/src/dwl",
+	"dwl/statusbar.c at main - Mozilla Firefox",
+};
+
+// what renderbar() uses of the Buffer the bar is copied into
+struct bench_buffer {
+	uint32_t *data;
+	int stride;
+};
+
+// what renderbar() uses of a Monitor
+struct bench_monitor {
+	struct Drwl *drw;
+	int width, height;
+	int lrpad;
+	uint32_t tagset;
+	struct bench_buffer buffer;
+};
+
+static struct color schemes[LENGTH(colors)][2];
+
+static double now_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p) {
+	return sorted[(int)(p * (n - 1) + 0.5)];
+}
+
+// the state shown by the bar in frame n of a workload
+static void update_state(enum workload workload, int n, struct system_info *info,
+		uint32_t *tagset, const char **title) {
+	int minute = workload == LoadIdle ? 0 : n;
+
+	snprintf(info->date.date, DATE_STR_MAX, "Fri Oct 16 %02d:%02d", minute / 60 % 24, minute % 60);
+	if (workload != LoadFull) {
+		return;
+	}
+
+	info->charge.capacity = n % 101;
+	info->charge.status = n % 2 ? Charging : Discharging;
+	snprintf(info->temp.celsius, TEMP_STR_MAX, "%d°C", 40 + n % 40);
+	snprintf(info->memory.usage_ratio, MEMORY_STR_MAX, "%d%%", n % 100);
+	info->network.quality = n % 100;
+	snprintf(info->network.name, sizeof(info->network.name), "network-%d", n % 7);
+	*tagset = 1u << (n % LENGTH(tags));
+	*title = titles[n % LENGTH(titles)];
+}
+
+static void render_bar(struct bench_monitor *m, struct system_info *info, const char *title) {
+	// clients on tags 2 & 4, the focused one on the shown tag
+	struct bar_state bar = {
+		.tags = tags, .tag_count = LENGTH(tags),
+		.tagset = m->tagset, .occupied = 0x0a, .focused = m->tagset,
+		.title = title, .client = title, .selected = 1,
+		.lrpad = m->lrpad,
+		.norm = schemes[0], .sel = schemes[1],
+	};
+	int i, y;
+	int32_t stride;
+	unsigned char *pixels;
+
+	drwl_draw_bar(m->drw, info, &bar, m->width, m->height);
+
+	// the copy into the client buffer is part of the frame as well
+	stride = cairo_image_surface_get_stride(m->drw->surface);
+	pixels = cairo_image_surface_get_data(m->drw->surface);
+	for (i = 0; i < m->drw->damage_count; i++) {
+		for (y = 0; y < m->height; y++) {
+			memcpy(m->buffer.data + y * m->buffer.stride + m->drw->damage[i].x,
+					pixels + y * stride + m->drw->damage[i].x * 4,
+					m->drw->damage[i].width * 4);
+		}
+	}
+}
+
+static int run(const char *font, float scale, int width, enum workload workload,
+		int frames, int fast_text) {
+	struct bench_monitor m = { 0 };
+	struct system_info info = { 0 };
+	struct alloc_stats allocs;
+	const char *title = titles[0];
+	double *times, start, create, cold;
+	int n;
+
+	times = calloc(frames, sizeof(*times));
+	if (!times) {
+		return 1;
+	}
+
+	info.network.type = Wireless;
+	info.charge.plugged_in = 1;
+	update_state(LoadFull, 0, &info, &m.tagset, &title);
+
+	start = now_us();
+	m.drw = drwl_create(font, scale, fast_text);
+	create = now_us() - start;
+	if (!m.drw) {
+		free(times);
+		return 1;
+	}
+
+	// same sizes as updatebar() in dwl.c
+	m.width = width;
+	m.lrpad = m.drw->font->height;
+	m.height = m.drw->font->height + (int)(2 * scale + 0.5f);
+	m.buffer.stride = width;
+	m.buffer.data = calloc((size_t)width * m.height, sizeof(uint32_t));
+	if (!m.buffer.data) {
+		drwl_destroy(m.drw);
+		free(times);
+		return 1;
+	}
+
+	start = now_us();
+	render_bar(&m, &info, title);
+	cold = now_us() - start;
+
+	alloc_start();
+	for (n = 0; n < frames; n++) {
+		update_state(workload, n + 1, &info, &m.tagset, &title);
+		start = now_us();
+		render_bar(&m, &info, title);
+		times[n] = now_us() - start;
+	}
+	alloc_stop(&allocs);
+
+	qsort(times, frames, sizeof(*times), compare_doubles);
+	printf("%-16s %5.2f %6d %-6s %9.0f %9.0f %8.1f %8.1f %8.1f %8.1f %8.1f %10.0f\n",
+			font, scale, width, workload_names[workload], create, cold,
+			percentile(times, frames, 0.5), percentile(times, frames, 0.9),
+			percentile(times, frames, 0.99), times[frames - 1],
+			(double)allocs.count / frames, (double)allocs.bytes / frames);
+
+	free(m.buffer.data);
+	drwl_destroy(m.drw);
+	free(times);
+	return 0;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [-n frames] [-p] [-f font]... [-s scale]... [-w width]...\n", name);
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	const char *fonts[MAX_ARGS] = { "monospace 10", "sans 12" };
+	float scales[MAX_ARGS] = { 1.0f, 1.5f, 2.0f };
+	int widths[MAX_ARGS] = { 1280, 1920, 3840 };
+	int font_count = 2, scale_count = 3, width_count = 3;
+	int user_fonts = 0, user_scales = 0, user_widths = 0;
+	int frames = 1000, fast_text = 1, failed = 0;
+	int opt, f, s, w, workload;
+	size_t i, j;
+
+	while ((opt = getopt(argc, argv, "n:pf:s:w:")) != -1) {
+		switch (opt) {
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'p':
+			// text goes through pango only, see glyph_cache_render()
+			fast_text = 0;
+			break;
+		case 'f':
+			if (user_fonts == MAX_ARGS) {
+				usage(argv[0]);
+			}
+			fonts[user_fonts++] = optarg;
+			font_count = user_fonts;
+			break;
+		case 's':
+			if (user_scales == MAX_ARGS) {
+				usage(argv[0]);
+			}
+			scales[user_scales++] = (float)strtod(optarg, NULL);
+			scale_count = user_scales;
+			break;
+		case 'w':
+			if (user_widths == MAX_ARGS) {
+				usage(argv[0]);
+			}
+			widths[user_widths++] = atoi(optarg);
+			width_count = user_widths;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (frames < 1) {
+		usage(argv[0]);
+	}
+
+	for (i = 0; i < LENGTH(colors); i++) {
+		for (j = 0; j < LENGTH(colors[i]); j++) {
+			color_init(&schemes[i][j], colors[i][j]);
+		}
+	}
+
+	printf("%d frames per run, glyph cache %s, times in us, allocations per frame\n",
+			frames, fast_text ? "on" : "off");
+	printf("%-16s %5s %6s %-6s %9s %9s %8s %8s %8s %8s %8s %10s\n",
+			"font", "scale", "width", "load", "create", "first",
+			"p50", "p90", "p99", "max", "allocs", "bytes");
+
+	for (f = 0; f < font_count; f++) {
+		for (s = 0; s < scale_count; s++) {
+			for (w = 0; w < width_count; w++) {
+				for (workload = 0; workload < LoadLast; workload++) {
+					if (run(fonts[f], scales[s], widths[w], workload, frames, fast_text)) {
+						fprintf(stderr, "failed to render the bar with font %s\n", fonts[f]);
+						failed = 1;
+					}
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < LENGTH(colors); i++) {
+		for (j = 0; j < LENGTH(colors[i]); j++) {
+			color_finish(&schemes[i][j]);
+		}
+	}
+
+	return failed;
+}
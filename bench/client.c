@@ -0,0 +1,385 @@
+// Synthetic client for `make bench`. It is started by a dwl built with
+// -DPROBES, and that dwl quits and prints its probes once this exits.
+//
+// Every round maps the windows spread over all tags, views each tag
+// through a virtual keyboard, sweeps a virtual pointer across the outputs
+// and unmaps everything again. Tags are switched with MODKEY+1..5,
+// so the bindings of config.def.h are assumed.
+//
+// usage: bench/client [-w windows] [-r rounds] [-m motions]
+#include "virtual-keyboard-unstable-v1-client-protocol.h"
+#include "wlr-virtual-pointer-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#include <fcntl.h>
+#include <linux/input-event-codes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+
+#define TAG_COUNT (5)
+#define BUFFER_SIZE (64)
+// windows mapped between two round trips
+#define MAP_BATCH (16)
+#define MOTION_BATCH (64)
+
+struct window {
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	int attached;
+};
+
+static struct wl_display *display;
+static struct wl_compositor *compositor;
+static struct wl_shm *shm;
+static struct wl_seat *seat;
+static struct xdg_wm_base *wm_base;
+static struct zwp_virtual_keyboard_manager_v1 *keyboard_manager;
+static struct zwlr_virtual_pointer_manager_v1 *pointer_manager;
+static int output_count;
+
+static struct zwp_virtual_keyboard_v1 *keyboard;
+static struct zwlr_virtual_pointer_v1 *pointer;
+static uint32_t modkey_mask;
+// every window shows the same pixels
+static struct wl_buffer *buffer;
+
+static double now_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint32_t timestamp(void) {
+	return (uint32_t)now_ms();
+}
+
+// anonymous shared memory of the given size, the object is unlinked right away
+static int shm_create(size_t size) {
+	static unsigned int serial;
+	char name[64];
+	int fd;
+
+	snprintf(name, sizeof(name), "/dwl-bench-%ld-%u", (long)getpid(), serial++);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		perror("shm_open");
+		return -1;
+	}
+	shm_unlink(name);
+
+	if (ftruncate(fd, size) < 0) {
+		perror("ftruncate");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void wm_base_ping(void *data, struct xdg_wm_base *base, uint32_t serial) {
+	xdg_wm_base_pong(base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void registry_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0 && !seat) {
+		seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(wm_base, &wm_base_listener, NULL);
+	} else if (strcmp(interface, zwp_virtual_keyboard_manager_v1_interface.name) == 0) {
+		keyboard_manager = wl_registry_bind(registry, name,
+				&zwp_virtual_keyboard_manager_v1_interface, 1);
+	} else if (strcmp(interface, zwlr_virtual_pointer_manager_v1_interface.name) == 0) {
+		pointer_manager = wl_registry_bind(registry, name,
+				&zwlr_virtual_pointer_manager_v1_interface, 1);
+	} else if (strcmp(interface, wl_output_interface.name) == 0) {
+		output_count++;
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+	struct window *window = data;
+
+	xdg_surface_ack_configure(xdg_surface, serial);
+	// the first buffer maps the window, mapnotify() runs for it
+	if (!window->attached) {
+		wl_surface_attach(window->surface, buffer, 0, 0);
+		window->attached = 1;
+	}
+	wl_surface_commit(window->surface);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states) {
+}
+
+static void toplevel_close(void *data, struct xdg_toplevel *toplevel) {
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = toplevel_configure,
+	.close = toplevel_close,
+};
+
+static int create_buffer(void) {
+	struct wl_shm_pool *pool;
+	size_t size = BUFFER_SIZE * BUFFER_SIZE * 4;
+	uint32_t *pixels;
+	size_t i;
+	int fd;
+
+	fd = shm_create(size);
+	if (fd < 0) {
+		return 1;
+	}
+
+	pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (pixels == MAP_FAILED) {
+		close(fd);
+		return 1;
+	}
+	for (i = 0; i < BUFFER_SIZE * BUFFER_SIZE; i++) {
+		pixels[i] = 0xff458588;
+	}
+	munmap(pixels, size);
+
+	pool = wl_shm_create_pool(shm, fd, size);
+	buffer = wl_shm_pool_create_buffer(pool, 0, BUFFER_SIZE, BUFFER_SIZE,
+			BUFFER_SIZE * 4, WL_SHM_FORMAT_ARGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	return 0;
+}
+
+// the compositor is handed the keymap of xkbcommon's defaults
+static int create_keyboard(void) {
+	struct xkb_context *context;
+	struct xkb_keymap *keymap;
+	char *text, *mapped;
+	size_t size;
+	int fd;
+
+	context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	if (!context) {
+		return 1;
+	}
+	keymap = xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!keymap) {
+		xkb_context_unref(context);
+		return 1;
+	}
+
+	modkey_mask = 1u << xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_ALT);
+	text = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+	size = strlen(text) + 1;
+	xkb_keymap_unref(keymap);
+	xkb_context_unref(context);
+
+	fd = shm_create(size);
+	if (fd < 0) {
+		free(text);
+		return 1;
+	}
+	mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapped == MAP_FAILED) {
+		free(text);
+		close(fd);
+		return 1;
+	}
+	memcpy(mapped, text, size);
+	munmap(mapped, size);
+	free(text);
+
+	keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(keyboard_manager, seat);
+	zwp_virtual_keyboard_v1_keymap(keyboard, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, fd, size);
+	close(fd);
+
+	return 0;
+}
+
+// MODKEY+1..5, like pressing it on a real keyboard
+static void view_tag(int tag) {
+	zwp_virtual_keyboard_v1_modifiers(keyboard, modkey_mask, 0, 0, 0);
+	zwp_virtual_keyboard_v1_key(keyboard, timestamp(), KEY_1 + tag, WL_KEYBOARD_KEY_STATE_PRESSED);
+	zwp_virtual_keyboard_v1_key(keyboard, timestamp(), KEY_1 + tag, WL_KEYBOARD_KEY_STATE_RELEASED);
+	zwp_virtual_keyboard_v1_modifiers(keyboard, 0, 0, 0, 0);
+}
+
+static void map_window(struct window *window, int index) {
+	char title[32];
+
+	window->surface = wl_compositor_create_surface(compositor);
+	window->xdg_surface = xdg_wm_base_get_xdg_surface(wm_base, window->surface);
+	xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener, window);
+	window->toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+	xdg_toplevel_add_listener(window->toplevel, &toplevel_listener, window);
+
+	snprintf(title, sizeof(title), "bench %d", index);
+	xdg_toplevel_set_title(window->toplevel, title);
+	xdg_toplevel_set_app_id(window->toplevel, "dwl-bench");
+	window->attached = 0;
+	// the initial commit asks for a configure, see xdg_surface_configure()
+	wl_surface_commit(window->surface);
+}
+
+static void unmap_window(struct window *window) {
+	xdg_toplevel_destroy(window->toplevel);
+	xdg_surface_destroy(window->xdg_surface);
+	wl_surface_destroy(window->surface);
+}
+
+static void report(const char *phase, int count, const char *unit, double start) {
+	double elapsed = now_ms() - start;
+
+	printf("%-8s %6d %-8s %10.1f ms %10.1f us/%s\n", phase, count, unit,
+			elapsed, elapsed * 1e3 / count, unit);
+	fflush(stdout);
+}
+
+static void run_round(struct window *windows, int window_count, int motions) {
+	double start;
+	int i, tag;
+
+	// every tag gets an equal share of the windows
+	start = now_ms();
+	for (i = 0; i < window_count; i++) {
+		tag = i * TAG_COUNT / window_count;
+		if (i == 0 || tag != (i - 1) * TAG_COUNT / window_count) {
+			view_tag(tag);
+		}
+		map_window(&windows[i], i);
+		if (i % MAP_BATCH == MAP_BATCH - 1) {
+			wl_display_roundtrip(display);
+		}
+	}
+	// one for the configures, one for the buffers they attached
+	wl_display_roundtrip(display);
+	wl_display_roundtrip(display);
+	report("map", window_count, "window", start);
+
+	start = now_ms();
+	for (tag = 0; tag < TAG_COUNT; tag++) {
+		view_tag(tag);
+		wl_display_roundtrip(display);
+	}
+	report("view", TAG_COUNT, "tag", start);
+
+	// back and forth over the width of every output
+	start = now_ms();
+	for (i = 0; i < motions; i++) {
+		int direction = i / 256 % 2 ? -1 : 1;
+
+		zwlr_virtual_pointer_v1_motion(pointer, timestamp(),
+				wl_fixed_from_int(direction * 8 * output_count), wl_fixed_from_int(direction * 3));
+		zwlr_virtual_pointer_v1_frame(pointer);
+		if (i % MOTION_BATCH == MOTION_BATCH - 1) {
+			wl_display_roundtrip(display);
+		}
+	}
+	wl_display_roundtrip(display);
+	report("motion", motions, "event", start);
+
+	start = now_ms();
+	for (i = 0; i < window_count; i++) {
+		unmap_window(&windows[i]);
+	}
+	wl_display_roundtrip(display);
+	report("unmap", window_count, "window", start);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [-w windows] [-r rounds] [-m motions]\n", name);
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	struct wl_registry *registry;
+	struct window *windows;
+	int window_count = 200, rounds = 3, motions = 2048;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "w:r:m:")) != -1) {
+		switch (opt) {
+		case 'w':
+			window_count = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'm':
+			motions = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (window_count < 1 || rounds < 1 || motions < 1) {
+		usage(argv[0]);
+	}
+
+	display = wl_display_connect(NULL);
+	if (!display) {
+		fprintf(stderr, "failed to connect to the compositor\n");
+		return 1;
+	}
+
+	registry = wl_display_get_registry(display);
+	wl_registry_add_listener(registry, &registry_listener, NULL);
+	wl_display_roundtrip(display);
+	if (!compositor || !shm || !seat || !wm_base || !keyboard_manager || !pointer_manager) {
+		fprintf(stderr, "the compositor lacks a required global\n");
+		return 1;
+	}
+
+	windows = calloc(window_count, sizeof(*windows));
+	if (!windows || create_buffer() || create_keyboard()) {
+		fprintf(stderr, "failed to set up the client\n");
+		return 1;
+	}
+	pointer = zwlr_virtual_pointer_manager_v1_create_virtual_pointer(pointer_manager, seat);
+	wl_display_roundtrip(display);
+
+	printf("%d outputs, %d windows, %d rounds\n", output_count, window_count, rounds);
+	for (i = 0; i < rounds; i++) {
+		run_round(windows, window_count, motions);
+	}
+
+	zwlr_virtual_pointer_v1_destroy(pointer);
+	zwp_virtual_keyboard_v1_destroy(keyboard);
+	wl_buffer_destroy(buffer);
+	free(windows);
+	wl_registry_destroy(registry);
+	wl_display_disconnect(display);
+
+	return 0;
+}
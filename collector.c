@@ -0,0 +1,833 @@
+#include "collector.h"
+#include "wifi.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/ioctl.h>
+
+#define AC "/sys/class/power_supply/AC/"
+#define BAT0 "/sys/class/power_supply/BAT0/"
+
+// sysfs attributes are a single short line
+#define STATBUFSIZ (64)
+// enough for the head of /proc/meminfo
+#define MEMINFO_BUFSIZ (512)
+
+// wired & wireless interfaces considered for the network panel
+#define MAX_INTERFACES (8)
+
+// large enough for any uevent or a burst of route notifications
+#define NETLINK_BUFSIZ (8192)
+
+static void formatdate(struct time_info *date) {
+	time_t now = time(NULL);
+	struct tm tm;
+	// runs on the collector thread
+	if (localtime_r(&now, &tm) == NULL) return;
+
+	// ISO Date format, 12 hours
+	// YYYY-MM-DD HH:MM AM/PM
+	strftime(date->date, DATE_STR_MAX, "%F %I:%M %p", &tm);
+}
+
+// Files read again on every refresh. Each one is opened once in
+// collector_start() and read with pread(), so a refresh costs
+// a single syscall per file and never touches the heap or stdio.
+// Power supplies come and go, their files are opened again whenever
+// one is added or removed, see uevent_in()
+enum stat_source {
+	StatAcOnline,
+	StatBatCapacity,
+	StatBatStatus,
+	StatTemp,
+	StatMeminfo,
+	StatLast
+};
+
+static struct {
+	const char *path;
+	int fd;
+} stat_sources[StatLast] = {
+	[StatAcOnline] = { AC "online", -1 },
+	[StatBatCapacity] = { BAT0 "capacity", -1 },
+	[StatBatStatus] = { BAT0 "status", -1 },
+	[StatTemp] = { "/sys/class/thermal/thermal_zone0/temp", -1 },
+	[StatMeminfo] = { "/proc/meminfo", -1 },
+};
+
+static void stat_open(void) {
+	int i;
+
+	// missing files (no battery, no thermal zone) are simply skipped
+	for (i = 0; i < StatLast; i++) {
+		stat_sources[i].fd = open(stat_sources[i].path, O_RDONLY | O_CLOEXEC);
+	}
+}
+
+static void stat_reopen(enum stat_source source) {
+	if (stat_sources[source].fd != -1) {
+		close(stat_sources[source].fd);
+	}
+	stat_sources[source].fd = open(stat_sources[source].path, O_RDONLY | O_CLOEXEC);
+}
+
+static void stat_close(void) {
+	int i;
+
+	for (i = 0; i < StatLast; i++) {
+		if (stat_sources[i].fd != -1) {
+			close(stat_sources[i].fd);
+		}
+		stat_sources[i].fd = -1;
+	}
+}
+
+// Reads the start of a stat source into a null terminated buffer.
+// sysfs & procfs generate the contents again when read from offset 0.
+static int stat_read(enum stat_source source, char *buffer, size_t size) {
+	ssize_t len;
+
+	if (stat_sources[source].fd == -1) {
+		return 1;
+	}
+
+	len = pread(stat_sources[source].fd, buffer, size - 1, 0);
+	if (len <= 0) {
+		return 1;
+	}
+
+	buffer[len] = '\0';
+	return 0;
+}
+
+// Parses the next decimal integer at or after *cursor
+// and moves the cursor past it. strtol without the locale.
+static long scan_long(const char **cursor) {
+	const char *s = *cursor;
+	long value = 0;
+	int negative = 0;
+
+	while (*s && *s != '-' && (*s < '0' || *s > '9')) {
+		s++;
+	}
+
+	if (*s == '-') {
+		negative = 1;
+		s++;
+	}
+
+	while (*s >= '0' && *s <= '9') {
+		value = value * 10 + (*s++ - '0');
+	}
+
+	*cursor = s;
+	return negative ? -value : value;
+}
+
+static void formatbat(struct battery_info *info) {
+	char buffer[STATBUFSIZ];
+	const char *cursor;
+
+	if (stat_read(StatAcOnline, buffer, sizeof(buffer))) {
+		return;
+	}
+	cursor = buffer;
+	info->plugged_in = (int)scan_long(&cursor);
+
+	if (stat_read(StatBatCapacity, buffer, sizeof(buffer))) {
+		return;
+	}
+	cursor = buffer;
+	info->capacity = (int)scan_long(&cursor);
+
+	if (stat_read(StatBatStatus, buffer, sizeof(buffer))) {
+		return;
+	}
+
+	// Assuming implementation of /sys/class/power_supply/BAT0/status
+	// prints shorthand of "Discharging", "Charging", "Full", and "Not charging" (Inhibited)
+	switch (buffer[0]) {
+	case 'D':
+		info->status = Discharging;
+		break;
+	case 'C':
+		info->status = Charging;
+		break;
+	case 'F':
+		info->status = Full;
+		break;
+	case 'N':
+		info->status = Inhibited;
+		break;
+	}
+}
+
+static void formattemp(struct temp_info *temp) {
+	char buffer[STATBUFSIZ];
+	const char *cursor = buffer;
+	int celsius;
+
+	if (stat_read(StatTemp, buffer, sizeof(buffer))) {
+		return;
+	}
+
+	// reported in millidegrees
+	celsius = (int)(scan_long(&cursor) / 1000);
+
+	snprintf(temp->celsius, TEMP_STR_MAX, "%d\U000000B0C", celsius);
+}
+
+static int cmp(const char *_haystack, const char *_needle) {
+	return (strncmp(_haystack, _needle, strlen(_needle)) == 0);
+}
+
+static void formatram(struct memory_info *info) {
+	// every field we need is within the first few lines
+	char buffer[MEMINFO_BUFSIZ];
+	const char *line = buffer;
+	long memtotal = 0;
+	long memfree = 0;
+	long buffers = 0;
+	long cached = 0;
+	double gb = 1 << 20; // values are in kB
+	double memused;
+
+	if (stat_read(StatMeminfo, buffer, sizeof(buffer))) {
+		return;
+	}
+
+	while (*line) {
+		if (cmp(line, "MemTotal:")) {
+			memtotal = scan_long(&line);
+		} else if (cmp(line, "MemFree:")) {
+			memfree = scan_long(&line);
+		} else if (cmp(line, "Buffers:")) {
+			buffers = scan_long(&line);
+		} else if (cmp(line, "Cached:")) {
+			cached = scan_long(&line);
+		}
+
+		// early exit
+		if (memtotal && memfree && buffers && cached) break;
+
+		if (!(line = strchr(line, '\n'))) break;
+		line++;
+	}
+
+	memused = (double)(memtotal - memfree - buffers - cached) / gb;
+
+	snprintf(info->usage_ratio, MEMORY_STR_MAX, "%.1fGb/%.1fGb", memused, (double)memtotal / gb);
+}
+
+// Interfaces that can carry the network panel. Resolving them walks every
+// address of every interface and dumps the routes, so it is only done again
+// after rtnetlink reported a link, address or route change, see route_in()
+static struct {
+	// long lived socket for the interface ioctls
+	int fd;
+	// long lived rtnetlink socket for the route dumps
+	int route_fd;
+	// station info of wireless interfaces
+	struct wifi wifi;
+	int resolved;
+	int count;
+	struct interface {
+		char name[IFNAMSIZ];
+		unsigned int index;
+		int wireless;
+		// bridges, veths, tun devices & the like, backed by no hardware
+		int virtual;
+		// carries a default route, with the given metric
+		int routed;
+		uint32_t metric;
+	} interfaces[MAX_INTERFACES];
+} network = { .fd = -1, .route_fd = -1, .wifi = { .fd = -1, .event_fd = -1 } };
+
+static int interface_known(const char *name) {
+	int i;
+
+	for (i = 0; i < network.count; i++) {
+		if (strcmp(network.interfaces[i].name, name) == 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Link local addresses are there as soon as a link is up, they don't
+// make an interface connected
+static int address_usable(const struct sockaddr *addr) {
+	const struct in6_addr *in6;
+
+	if (addr->sa_family == AF_INET) {
+		return (ntohl(((const struct sockaddr_in *)addr)->sin_addr.s_addr) >> 16) != 0xa9fe;
+	}
+
+	in6 = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+	return !IN6_IS_ADDR_LINKLOCAL(in6);
+}
+
+static void route_default(unsigned int index, uint32_t metric) {
+	int i;
+
+	for (i = 0; i < network.count; i++) {
+		if (network.interfaces[i].index == index
+				&& (!network.interfaces[i].routed || metric < network.interfaces[i].metric)) {
+			network.interfaces[i].routed = 1;
+			network.interfaces[i].metric = metric;
+		}
+	}
+}
+
+// Marks the interfaces that default routes of the main table go out of
+static void resolve_routes(void) {
+	struct {
+		struct nlmsghdr header;
+		struct rtmsg route;
+	} request = {
+		.header = {
+			.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg)),
+			.nlmsg_type = RTM_GETROUTE,
+			.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+		},
+		.route = { .rtm_family = AF_UNSPEC },
+	};
+	char buffer[NETLINK_BUFSIZ];
+	struct nlmsghdr *msg;
+	struct rtmsg *route;
+	struct rtattr *attr;
+	unsigned int index;
+	uint32_t metric, table;
+	ssize_t len;
+	int attr_len;
+
+	if (network.route_fd == -1) {
+		network.route_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+		if (network.route_fd == -1) {
+			return;
+		}
+	}
+
+	if (send(network.route_fd, &request, request.header.nlmsg_len, 0) == -1) {
+		return;
+	}
+
+	while ((len = recv(network.route_fd, buffer, sizeof(buffer), 0)) > 0) {
+		for (msg = (struct nlmsghdr *)buffer; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+			if (msg->nlmsg_type == NLMSG_DONE || msg->nlmsg_type == NLMSG_ERROR) {
+				return;
+			}
+			if (msg->nlmsg_type != RTM_NEWROUTE) {
+				continue;
+			}
+
+			route = NLMSG_DATA(msg);
+			if (route->rtm_dst_len != 0 || route->rtm_type != RTN_UNICAST) {
+				continue;
+			}
+
+			index = 0;
+			metric = 0;
+			table = route->rtm_table;
+			attr_len = (int)RTM_PAYLOAD(msg);
+			for (attr = RTM_RTA(route); RTA_OK(attr, attr_len); attr = RTA_NEXT(attr, attr_len)) {
+				switch (attr->rta_type) {
+				case RTA_OIF:
+					index = *(uint32_t *)RTA_DATA(attr);
+					break;
+				case RTA_PRIORITY:
+					metric = *(uint32_t *)RTA_DATA(attr);
+					break;
+				case RTA_TABLE:
+					table = *(uint32_t *)RTA_DATA(attr);
+					break;
+				}
+			}
+
+			if (index && table == RT_TABLE_MAIN) {
+				route_default(index, metric);
+			}
+		}
+	}
+}
+
+static void resolve_interfaces(void) {
+	struct ifaddrs *head;
+	struct ifaddrs *list;
+	struct interface *interface;
+	struct ifreq ifr;
+	char path[64];
+
+	network.resolved = 1;
+	network.count = 0;
+
+	if (network.fd == -1) {
+		network.fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if (network.fd == -1) {
+			return;
+		}
+	}
+
+	if (getifaddrs(&head)) {
+		return;
+	}
+
+	for (list = head; list != NULL && network.count < MAX_INTERFACES; list = list->ifa_next) {
+		// only interfaces that are up and have an address are connected
+		if (!list->ifa_addr || (list->ifa_addr->sa_family != AF_INET && list->ifa_addr->sa_family != AF_INET6)) {
+			continue;
+		}
+
+		if (!(list->ifa_flags & IFF_UP) || !(list->ifa_flags & IFF_RUNNING)) {
+			continue;
+		}
+
+		// skip loopback device
+		if (list->ifa_flags & IFF_LOOPBACK) {
+			continue;
+		}
+
+		if (!address_usable(list->ifa_addr)) {
+			continue;
+		}
+
+		// skip any empty device names, every address is listed separately
+		if (!strlen(list->ifa_name) || strlen(list->ifa_name) >= IFNAMSIZ || interface_known(list->ifa_name)) {
+			continue;
+		}
+
+		// skip tunnels like wireguard, they have no link layer address
+		memset(&ifr, 0, sizeof(ifr));
+		strcpy(ifr.ifr_name, list->ifa_name);
+		if (ioctl(network.fd, SIOCGIFHWADDR, &ifr) == 0 && ifr.ifr_hwaddr.sa_family == ARPHRD_NONE) {
+			continue;
+		}
+
+		interface = &network.interfaces[network.count++];
+		strcpy(interface->name, list->ifa_name);
+		interface->index = if_nametoindex(list->ifa_name);
+		interface->routed = 0;
+		interface->metric = 0;
+
+		// only cfg80211 devices are known to nl80211
+		interface->wireless = wifi_is_wireless(&network.wifi, interface->index);
+
+		// only devices backed by hardware have a device link in sysfs
+		snprintf(path, sizeof(path), "/sys/class/net/%s/device", list->ifa_name);
+		interface->virtual = access(path, F_OK) != 0;
+	}
+
+	freeifaddrs(head);
+
+	resolve_routes();
+}
+
+// The interface with the cheapest default route carries the traffic. Without
+// a default route, a wired connection wins over a wireless one, and virtual
+// devices like docker0 or virbr0 only ever count when they carry the route
+static int interface_better(const struct interface *a, const struct interface *b) {
+	if (!a->routed && a->virtual) {
+		return 0;
+	}
+	if (!b) {
+		return 1;
+	}
+	if (a->routed != b->routed) {
+		return a->routed;
+	}
+	if (a->routed) {
+		return a->metric < b->metric;
+	}
+	return !a->wireless && b->wireless;
+}
+
+static void formatnetwork(struct network_info *info) {
+	const struct interface *best = NULL;
+	int i;
+
+	// default to disconnected just in case network is off
+	info->type = Disconnected;
+	info->name[0] = '\0';
+	info->quality = 0;
+
+	if (!network.resolved) {
+		resolve_interfaces();
+	}
+
+	for (i = 0; i < network.count; i++) {
+		if (interface_better(&network.interfaces[i], best)) {
+			best = &network.interfaces[i];
+		}
+	}
+
+	if (!best) {
+		return;
+	}
+
+	if (best->wireless) {
+		wifi_query(&network.wifi, best->index, info);
+		return;
+	}
+
+	info->type = Wired;
+	strcpy(info->name, best->name);
+}
+
+void formatstatusbar(struct system_info *info) {
+	formatnetwork(&info->network);
+
+	formatram(&info->memory);
+
+	formattemp(&info->temp);
+
+	formatbat(&info->charge);
+
+	formatdate(&info->date);
+}
+
+static int netlink_open(int protocol, uint32_t groups) {
+	struct sockaddr_nl addr = { 0 };
+	int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, protocol);
+	if (fd == -1) {
+		return -1;
+	}
+
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = groups;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// Arms the timer for the start of the next minute. The timer is canceled
+// when the clock is set, so suspend or an NTP jump can't leave it behind.
+static int clock_arm(int fd) {
+	struct itimerspec spec = { 0 };
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_REALTIME, &now) == -1) {
+		return -1;
+	}
+
+	spec.it_value.tv_sec = now.tv_sec - now.tv_sec % 60 + 60;
+	spec.it_interval.tv_sec = 60;
+
+	return timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL);
+}
+
+static int route_in(struct collector *collector) {
+	char buffer[NETLINK_BUFSIZ];
+	struct nlmsghdr *msg;
+	ssize_t len;
+	int changed = 0;
+
+	// drain the socket, a single refresh covers every notification
+	while ((len = recv(collector->route_fd, buffer, sizeof(buffer), 0)) > 0) {
+		for (msg = (struct nlmsghdr *)buffer; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+			switch (msg->nlmsg_type) {
+			case RTM_NEWLINK:
+			case RTM_DELLINK:
+			case RTM_NEWADDR:
+			case RTM_DELADDR:
+			case RTM_NEWROUTE:
+			case RTM_DELROUTE:
+				changed = 1;
+				break;
+			}
+		}
+	}
+
+	// the socket overflowed, something changed but we don't know what
+	if (len == -1 && errno == ENOBUFS) {
+		changed = 1;
+	}
+
+	if (changed) {
+		network.resolved = 0;
+		formatnetwork(&collector->collected.network);
+	}
+
+	return changed;
+}
+
+static int uevent_in(struct collector *collector) {
+	char buffer[NETLINK_BUFSIZ];
+	ssize_t len;
+	char *key;
+	int changed = 0, plugged = 0;
+
+	// a uevent is "action@devpath" followed by
+	// null terminated KEY=VALUE pairs
+	while ((len = recv(collector->uevent_fd, buffer, sizeof(buffer) - 1, 0)) > 0) {
+		buffer[len] = '\0';
+		for (key = buffer; key < buffer + len; key += strlen(key) + 1) {
+			if (strcmp(key, "SUBSYSTEM=power_supply") == 0) {
+				changed = 1;
+				plugged |= cmp(buffer, "add@") || cmp(buffer, "remove@");
+				break;
+			}
+		}
+	}
+
+	if (plugged) {
+		stat_reopen(StatAcOnline);
+		stat_reopen(StatBatCapacity);
+		stat_reopen(StatBatStatus);
+	}
+	if (changed) {
+		formatbat(&collector->collected.charge);
+	}
+
+	return changed;
+}
+
+static int clock_in(struct collector *collector) {
+	uint64_t expirations;
+
+	// the clock was set, the next minute moved
+	if (read(collector->clock_fd, &expirations, sizeof(expirations)) == -1 && errno == ECANCELED) {
+		clock_arm(collector->clock_fd);
+	}
+
+	// memory, temperature & signal strength don't notify anyone
+	// when they change, so they are refreshed together with the date
+	formatdate(&collector->collected.date);
+	formatnetwork(&collector->collected.network);
+	formatram(&collector->collected.memory);
+	formattemp(&collector->collected.temp);
+
+	return 1;
+}
+
+// Copies the worker's system info into the snapshot. The sequence is odd
+// while the copy is in progress, readers retry until they saw an even
+// sequence that didn't change while they were copying.
+static void collector_publish(struct collector *collector) {
+	unsigned int sequence = atomic_load_explicit(&collector->sequence, memory_order_relaxed);
+	uint64_t one = 1;
+
+	atomic_store_explicit(&collector->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	memcpy(&collector->snapshot, &collector->collected, sizeof(collector->snapshot));
+
+	atomic_store_explicit(&collector->sequence, sequence + 2, memory_order_release);
+
+	// wake up the compositor, see notify_in()
+	if (write(collector->notify_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+		perror("write");
+	}
+}
+
+static void collector_read(struct collector *collector, struct system_info *info) {
+	unsigned int before, after;
+
+	do {
+		before = atomic_load_explicit(&collector->sequence, memory_order_acquire);
+		memcpy(info, &collector->snapshot, sizeof(*info));
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&collector->sequence, memory_order_relaxed);
+	} while (before & 1 || before != after);
+}
+
+// The worker owns every change source. Anything in here may block on a
+// slow driver without stalling input or frame callbacks.
+static void *collector_run(void *data) {
+	struct collector *collector = data;
+	struct pollfd fds[5];
+	int changed;
+
+	// without nl80211 every interface is considered wired
+	wifi_open(&network.wifi);
+
+	// negative descriptors of sources that failed to open are ignored
+	fds[0] = (struct pollfd){ .fd = collector->stop_fd, .events = POLLIN };
+	fds[1] = (struct pollfd){ .fd = collector->route_fd, .events = POLLIN };
+	fds[2] = (struct pollfd){ .fd = collector->uevent_fd, .events = POLLIN };
+	fds[3] = (struct pollfd){ .fd = collector->clock_fd, .events = POLLIN };
+	fds[4] = (struct pollfd){ .fd = network.wifi.event_fd, .events = POLLIN };
+
+	formatstatusbar(&collector->collected);
+	collector_publish(collector);
+
+	for (;;) {
+		if (poll(fds, sizeof(fds) / sizeof(fds[0]), -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("poll");
+			break;
+		}
+
+		if (fds[0].revents) {
+			break;
+		}
+
+		changed = 0;
+		if (fds[1].revents & POLLIN) {
+			changed |= route_in(collector);
+		}
+		if (fds[2].revents & POLLIN) {
+			changed |= uevent_in(collector);
+		}
+		if (fds[3].revents & POLLIN) {
+			changed |= clock_in(collector);
+		}
+		if (fds[4].revents & POLLIN && wifi_event_in(&network.wifi)) {
+			formatnetwork(&collector->collected.network);
+			changed = 1;
+		}
+
+		if (changed) {
+			collector_publish(collector);
+		}
+	}
+
+	return NULL;
+}
+
+static int notify_in(int fd, uint32_t mask, void *data) {
+	struct collector *collector = data;
+	uint64_t count;
+
+	// several snapshots may have been published since,
+	// only the latest one matters
+	if (read(fd, &count, sizeof(count)) == -1) {
+		return 0;
+	}
+
+	collector_read(collector, collector->info);
+	collector->changed(collector->data);
+
+	return 0;
+}
+
+int collector_start(struct collector *collector, struct wl_event_loop *loop,
+		struct system_info *info, void (*changed)(void *data), void *data) {
+	sigset_t all, old;
+	int error;
+
+	collector->info = info;
+	collector->changed = changed;
+	collector->data = data;
+	collector->running = 0;
+	collector->notify_source = NULL;
+	collector->route_fd = collector->uevent_fd = collector->clock_fd = -1;
+	atomic_init(&collector->sequence, 0);
+
+	collector->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	collector->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (collector->notify_fd == -1 || collector->stop_fd == -1) {
+		perror("eventfd");
+		goto error;
+	}
+
+	stat_open();
+
+	collector->route_fd = netlink_open(NETLINK_ROUTE,
+			RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR
+			| RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE);
+
+	// group 1 receives the uevents straight from the kernel
+	collector->uevent_fd = netlink_open(NETLINK_KOBJECT_UEVENT, 1);
+
+	collector->clock_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (collector->clock_fd != -1 && clock_arm(collector->clock_fd) == -1) {
+		close(collector->clock_fd);
+		collector->clock_fd = -1;
+	}
+
+	collector->notify_source = wl_event_loop_add_fd(loop, collector->notify_fd,
+			WL_EVENT_READABLE, notify_in, collector);
+
+	// signals are handled by the compositor,
+	// the worker inherits a mask that blocks all of them
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	error = pthread_create(&collector->thread, NULL, collector_run, collector);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (error) {
+		fprintf(stderr, "pthread_create: %s\n", strerror(error));
+		goto error;
+	}
+	collector->running = 1;
+
+	if (collector->route_fd == -1 || collector->uevent_fd == -1 || collector->clock_fd == -1) {
+		return 1;
+	}
+
+	return 0;
+
+error:
+	// the bar still shows what was there at startup
+	formatstatusbar(info);
+	return 1;
+}
+
+void collector_stop(struct collector *collector) {
+	uint64_t one = 1;
+
+	if (collector->running) {
+		if (write(collector->stop_fd, &one, sizeof(one)) == -1) {
+			perror("write");
+		}
+		pthread_join(collector->thread, NULL);
+		collector->running = 0;
+	}
+
+	if (collector->notify_source) {
+		wl_event_source_remove(collector->notify_source);
+	}
+
+	if (collector->route_fd != -1) {
+		close(collector->route_fd);
+	}
+	if (collector->uevent_fd != -1) {
+		close(collector->uevent_fd);
+	}
+	if (collector->clock_fd != -1) {
+		close(collector->clock_fd);
+	}
+	if (collector->notify_fd != -1) {
+		close(collector->notify_fd);
+	}
+	if (collector->stop_fd != -1) {
+		close(collector->stop_fd);
+	}
+
+	stat_close();
+
+	if (network.fd != -1) {
+		close(network.fd);
+		network.fd = -1;
+	}
+	if (network.route_fd != -1) {
+		close(network.route_fd);
+		network.route_fd = -1;
+	}
+	wifi_close(&network.wifi);
+	network.resolved = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <wayland-server-core.h>
+
+#include "stext.h"
+
+// Keeps a system_info up to date from a worker thread. Nothing is
+// polled, every part is refreshed when the kernel reports a change to it:
+// - network from rtnetlink link, address & route notifications
+// - battery from power_supply uevents
+// - date, memory & temperature when the wall clock minute changes
+// The compositor only ever sees complete snapshots, see collector_publish()
+struct collector {
+	// compositor side copy, updated right before changed() is called
+	struct system_info *info;
+	void (*changed)(void *data);
+	void *data;
+
+	pthread_t thread;
+	int running;
+
+	// worker -> compositor, readable once a new snapshot is published
+	int notify_fd;
+	struct wl_event_source *notify_source;
+	// compositor -> worker, asks it to exit
+	int stop_fd;
+
+	// only touched by the worker
+	struct system_info collected;
+	int route_fd;
+	int uevent_fd;
+	int clock_fd;
+
+	// seqlock protected copy of collected
+	atomic_uint sequence;
+	struct system_info snapshot;
+};
+
+void formatstatusbar(struct system_info *info);
+
+// starts the worker, info is filled in as soon as it published its first
+// snapshot. returns 0 on success, sources that fail to open are skipped
+int collector_start(struct collector *collector, struct wl_event_loop *loop,
+		struct system_info *info, void (*changed)(void *data), void *data);
+
+void collector_stop(struct collector *collector);
@@ -11,6 +11,7 @@ static const unsigned int snap = 32;
 static const int showbar = 1;
 static const int topbar = 1;
 static const char *font = "Terminus 12";
+static const int fasttext = 1; /* draw ascii text from a glyph cache instead of shaping it with pango */
 static const float rootcolor[] 		   = COLOR(0x181716ff);
 /* To conform the xdg-protocol, set the alpha to zero to restore the old behavior */
 static const float fullscreen_bg[]         = {0.1f, 0.1f, 0.1f, 1.0f}; /* You can also use glsl colors */
@@ -67,6 +68,12 @@ static const struct xkb_rule_names xkb_rules = {
 
 static const int repeat_rate = 25;
 static const int repeat_delay = 600;
+/* ms before a chord that was started is given up, 0 waits forever */
+static const int chordtimeout = 1000;
+
+/* Only move the cursor on pointer motion, and find what is under it once
+ * the event loop goes idle, instead of for every motion event */
+static const int batchmotion = 1;
 
 /* Trackpad */
 static const int tap_to_click = 1;
@@ -177,6 +184,20 @@ static const Key keys[] = {
 	CHVT(7), CHVT(8), CHVT(9), CHVT(10), CHVT(11), CHVT(12),
 };
 
+/* Key sequences, pressed one after the other. With mode set, the sequence
+ * stays at its last prefix afterwards, so only the last key has to be pressed
+ * again; any other key, or chordtimeout, leaves it and is handled as usual.
+ * A chord that starts with a key of keys[] or clashes with another chord is
+ * reported and ignored. None are bound by default, e.g. MODKEY+w, then j or
+ * k as often as needed to cycle the focus:
+ *	{ { { MODKEY, XKB_KEY_w }, { 0, XKB_KEY_j } },                 1,   focusstack, {.i = +1} },
+ *	{ { { MODKEY, XKB_KEY_w }, { 0, XKB_KEY_k } },                 1,   focusstack, {.i = -1} },
+ */
+static const Chord chords[] = {
+	/* keys                                                        mode function   argument */
+	{ { { 0, XKB_KEY_NoSymbol } },                                 0,   NULL,       {0} }, /* no keys, does nothing */
+};
+
 static const Button buttons[] = {
 	{ MODKEY | WLR_MODIFIER_SHIFT, BTN_SIDE, spawn, { .v = playerctl_playpause } },
 	{ MODKEY, BTN_EXTRA, spawn, { .v = playerctl_next } },
@@ -9,6 +9,8 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
@@ -71,6 +73,11 @@
 
 #include "util.h"
 #include "stext.h"
+#include "collector.h"
+#include "frames.h"
+#include "probes.h"
+#include "stats.h"
+#include "trace.h"
 
 /* macros */
 #define MAX(A, B)               ((A) > (B) ? (A) : (B))
@@ -79,10 +86,19 @@
 #define VISIBLEON(C, M)         ((M) && (C)->mon == (M) && ((C)->tags & (M)->tagset[(M)->seltags]))
 #define LENGTH(X)               (sizeof X / sizeof X[0])
 #define END(A)                  ((A) + LENGTH(A))
+#define CHORDLEN                4
+#define GRIDSIZE                8
+#define GRIDCOL(M, X)           MIN(MAX(((X) - (M)->m.x) * GRIDSIZE / (M)->m.width, 0), GRIDSIZE - 1)
+#define GRIDROW(M, Y)           MIN(MAX(((Y) - (M)->m.y) * GRIDSIZE / (M)->m.height, 0), GRIDSIZE - 1)
 #define TAGMASK                 ((1u << LENGTH(tags)) - 1)
+#ifdef PROBES
+/* every handler is timed, see probes.h */
+#define LISTEN(E, L, H)         wl_signal_add((E), ((L)->notify = probe_handler((H), #H), (L)))
+#define LISTEN_STATIC(E, H)     do { static struct wl_listener _l; _l.notify = probe_handler((H), #H); wl_signal_add((E), &_l); } while (0)
+#else
 #define LISTEN(E, L, H)         wl_signal_add((E), ((L)->notify = (H), (L)))
 #define LISTEN_STATIC(E, H)     do { static struct wl_listener _l = {.notify = (H)}; wl_signal_add((E), &_l); } while (0)
-#define TEXTW(mon, text)        (text_width(mon->drw->font, text) + mon->lrpad)
+#endif
 
 /* enums */
 enum { SchemeNorm, SchemeSel, SchemeUrg }; /* color schemes */
@@ -156,6 +172,29 @@ typedef struct {
 	const Arg arg;
 } Key;
 
+typedef struct {
+	uint32_t mod;
+	xkb_keysym_t keysym;
+} Stroke;
+
+typedef struct {
+	Stroke keys[CHORDLEN]; /* up to the first XKB_KEY_NoSymbol */
+	int mode;
+	void (*func)(const Arg *);
+	const Arg arg;
+} Chord;
+
+/* one step of keys[] or chords[], see setupkeys() */
+typedef struct {
+	int node; /* chord prefix it follows, 0 for none */
+	uint32_t mod;
+	xkb_keysym_t keysym; /* XKB_KEY_NoSymbol in free slots */
+	int next; /* node entered by a chord prefix, 0 when func is called */
+	int mode;
+	void (*func)(const Arg *);
+	const Arg *arg;
+} Binding;
+
 typedef struct {
 	struct wl_list link;
 	struct wlr_keyboard_group *wlr_group;
@@ -199,6 +238,7 @@ struct Monitor {
 	struct wlr_scene_buffer *scene_buffer; /* bar buffer */
 	struct wlr_scene_rect *fullscreen_bg; /* See createmon() for info */
 	struct wl_listener frame;
+	struct wl_listener present;
 	struct wl_listener destroy;
 	struct wl_listener request_state;
 	struct wl_listener destroy_lock_surface;
@@ -221,13 +261,28 @@ struct Monitor {
 	char ltsymbol[16];
 	int asleep;
 	struct Drwl *drw;
+	Buffer *bar_buffers[3]; /* recycled once the scene releases them */
+	int bar_dirty; /* see drawbar() */
 	int lrpad;
+	struct frame_stats frames; /* see rendermon() */
+	struct {
+		unsigned int gen; /* indexgen it was built in */
+		size_t first[GRIDSIZE * GRIDSIZE + 1]; /* of each cell in c */
+		Client **c; /* top to bottom within each cell */
+		size_t size;
+	} grid; /* see buildgrid() */
+#ifdef PROBES
+	int trace_track;
+#endif
 };
 
 typedef struct {
     struct wlr_buffer base;
-    size_t stride;
-    uint32_t data[];
+    struct wl_listener release;
+    pixman_region32_t stale; /* not yet copied from the bar surface */
+    int busy; /* held by the scene */
+    size_t stride, size;
+    uint32_t *data; /* shared memory mapping, see shm_map() */
 } Buffer;
 
 typedef struct {
@@ -245,6 +300,18 @@ typedef struct {
 	struct wl_listener destroy;
 } PointerConstraint;
 
+typedef struct {
+	struct wlr_xdg_popup *popup;
+	struct wl_list link; /* popups */
+	struct wl_listener destroy;
+} Popup;
+
+typedef struct {
+	uint32_t hash; /* of the surface's place in the scene, see commitsurface() */
+	struct wl_listener commit;
+	struct wl_listener destroy;
+} SurfaceListener;
+
 typedef struct {
 	const char *id;
 	const char *title;
@@ -272,18 +339,29 @@ static void arrangelayers(Monitor *m);
 static void autostartexec(void);
 static void axisnotify(struct wl_listener *listener, void *data);
 static bool bar_accepts_input(struct wlr_scene_buffer *buffer, double *sx, double *sy);
+static Buffer *buffer_acquire(Monitor *m);
+static Buffer *buffer_create(int width, int height);
 static void buffer_destroy(struct wlr_buffer *buffer);
+static void buffer_release(struct wl_listener *listener, void *data);
+static void buffers_destroy(Monitor *m);
 static bool buffer_begin_data_ptr_access(struct wlr_buffer *buffer, uint32_t flags, void **data, uint32_t *format, size_t *stride);
 static void buffer_end_data_ptr_access(struct wlr_buffer *buffer);
+static struct wlr_box bufferbox(struct wlr_scene_buffer *buffer, int x, int y);
+static void buildgrid(Monitor *m);
 static void buttonpress(struct wl_listener *listener, void *data);
+static void cachehit(struct wlr_scene_node *node, int layer, double x, double y,
+		double sx, double sy, struct wlr_surface *surface, Client *c, LayerSurface *l);
+static int chordexpire(void *data);
 static void chvt(const Arg *arg);
 static void checkidleinhibitor(struct wlr_surface *exclude);
 static void cleanup(void);
 static void cleanupmon(struct wl_listener *listener, void *data);
+static int cliphit(struct wlr_scene_node *node, int lx, int ly, int px, int py, int *above);
 static void closemon(Monitor *m);
 static void commitlayersurfacenotify(struct wl_listener *listener, void *data);
 static void commitnotify(struct wl_listener *listener, void *data);
 static void commitpopup(struct wl_listener *listener, void *data);
+static void commitsurface(struct wl_listener *listener, void *data);
 static void createdecoration(struct wl_listener *listener, void *data);
 static void createidleinhibitor(struct wl_listener *listener, void *data);
 static void createkeyboard(struct wlr_keyboard *keyboard);
@@ -295,23 +373,32 @@ static void createnotify(struct wl_listener *listener, void *data);
 static void createpointer(struct wlr_pointer *pointer);
 static void createpointerconstraint(struct wl_listener *listener, void *data);
 static void createpopup(struct wl_listener *listener, void *data);
+static void createsurface(struct wl_listener *listener, void *data);
 static void cursorconstrain(struct wlr_pointer_constraint_v1 *constraint);
 static void cursorframe(struct wl_listener *listener, void *data);
 static void cursorwarptohint(void);
 static void destroydecoration(struct wl_listener *listener, void *data);
 static void destroydragicon(struct wl_listener *listener, void *data);
+static void destroyhit(struct wl_listener *listener, void *data);
 static void destroyidleinhibitor(struct wl_listener *listener, void *data);
 static void destroylayersurfacenotify(struct wl_listener *listener, void *data);
 static void destroylock(SessionLock *lock, int unlocked);
 static void destroylocksurface(struct wl_listener *listener, void *data);
 static void destroynotify(struct wl_listener *listener, void *data);
 static void destroypointerconstraint(struct wl_listener *listener, void *data);
+static void destroypopup(struct wl_listener *listener, void *data);
 static void destroysessionlock(struct wl_listener *listener, void *data);
 static void destroysessionmgr(struct wl_listener *listener, void *data);
+static void destroysurface(struct wl_listener *listener, void *data);
 static void destroykeyboardgroup(struct wl_listener *listener, void *data);
 static Monitor *dirtomon(enum wlr_direction dir);
 static void drawbar(Monitor *m);
 static void drawbars(void);
+static void dumpframes(FILE *file);
+static void fillgrid(Monitor *m, int count);
+static Binding *findbinding(int node, uint32_t mods, xkb_keysym_t sym);
+static void flushbars(void *data);
+static void flushmotion(void *data);
 static void focusclient(Client *c, int lift);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
@@ -322,10 +409,12 @@ static void handlesig(int signo);
 static void incnmaster(const Arg *arg);
 static void inputdevice(struct wl_listener *listener, void *data);
 static int keybinding(uint32_t mods, xkb_keysym_t sym);
+static uint32_t keyhash(int node, uint32_t mods, xkb_keysym_t sym);
 static void keypress(struct wl_listener *listener, void *data);
 static void keypressmod(struct wl_listener *listener, void *data);
 static int keyrepeat(void *data);
 static void killclient(const Arg *arg);
+static void loadcolors(void);
 static void locksession(struct wl_listener *listener, void *data);
 static void mapnotify(struct wl_listener *listener, void *data);
 static void maximizenotify(struct wl_listener *listener, void *data);
@@ -335,19 +424,24 @@ static void motionnotify(uint32_t time, struct wlr_input_device *device, double
 		double sy, double sx_unaccel, double sy_unaccel);
 static void motionrelative(struct wl_listener *listener, void *data);
 static void moveresize(const Arg *arg);
+static struct wlr_scene_node *nodeat(int layer, double x, double y, double *nx, double *ny);
 static void outputmgrapply(struct wl_listener *listener, void *data);
 static void outputmgrapplyortest(struct wlr_output_configuration_v1 *config, int test);
 static void outputmgrtest(struct wl_listener *listener, void *data);
 static void pointerfocus(Client *c, struct wlr_surface *surface,
 		double sx, double sy, uint32_t time);
+static int popupat(double x, double y);
 static void powermgrsetmode(struct wl_listener *listener, void *data);
+static void presentmon(struct wl_listener *listener, void *data);
 static void quit(const Arg *arg);
+static void renderbar(Monitor *m);
 static void rendermon(struct wl_listener *listener, void *data);
 static void requestdecorationmode(struct wl_listener *listener, void *data);
 static void requeststartdrag(struct wl_listener *listener, void *data);
 static void requestmonstate(struct wl_listener *listener, void *data);
 static void resize(Client *c, struct wlr_box geo, int interact);
 static void run(char *startup_cmd);
+static void setchord(int node);
 static void setcursor(struct wl_listener *listener, void *data);
 static void setcursorshape(struct wl_listener *listener, void *data);
 static void setfloating(Client *c, int floating);
@@ -359,9 +453,10 @@ static void setmon(Client *c, Monitor *m, uint32_t newtags);
 static void setpsel(struct wl_listener *listener, void *data);
 static void setsel(struct wl_listener *listener, void *data);
 static void setup(void);
+static void setupkeys(void);
 static void spawn(const Arg *arg);
 static void startdrag(struct wl_listener *listener, void *data);
-static int status_in(void *data);
+static void status_in(void *data);
 static void tag(const Arg *arg);
 static void tagmon(const Arg *arg);
 static void tile(Monitor *m);
@@ -388,6 +483,7 @@ static void zoom(const Arg *arg);
 /* variables */
 static const char broken[] = "broken";
 static pid_t child_pid = -1;
+static int exitwithchild; /* -x, see handlesig() */
 static int locked;
 static void *exclusive_focus;
 static struct wl_display *dpy;
@@ -396,6 +492,25 @@ static struct wlr_backend *backend;
 static struct wlr_scene *scene;
 static struct wlr_scene_tree *layers[NUM_LAYERS];
 static struct wlr_scene_tree *drag_icon;
+/* Bumped by what changes the scene under the pointer and doesn't bump
+ * indexgen: commits that move, resize or restack a surface, or change its
+ * input region (all in commitsurface()), layer surfaces, the bar and the
+ * session lock. Cursor and drag icon surfaces are not in layers[] */
+static unsigned int scenegen = 1;
+/* the last surface found by xytonode(), see cachehit() */
+static struct {
+	struct wlr_box box; /* where the same surface would be found again */
+	int x, y; /* layout position of the surface */
+	struct wlr_scene_node *node;
+	struct wlr_surface *surface;
+	Client *c;
+	LayerSurface *l;
+	unsigned int gen; /* scenegen it was found in, 0 for none */
+	unsigned int index; /* indexgen it was found in */
+	struct wl_listener destroy;
+} hit;
+/* bumped by anything that moves, restacks, shows or hides clients */
+static unsigned int indexgen = 1;
 /* Map from ZWLR_LAYER_SHELL_* constants to Lyr* enum */
 static const int layermap[] = { LyrBg, LyrBottom, LyrTop, LyrOverlay };
 static struct wlr_renderer *drw;
@@ -407,6 +522,7 @@ static struct wlr_xdg_shell *xdg_shell;
 static struct wlr_xdg_activation_v1 *activation;
 static struct wlr_xdg_decoration_manager_v1 *xdg_decoration_mgr;
 static struct wl_list clients; /* tiling order */
+static struct wl_list popups; /* Popup.link, of clients, see nodeat() */
 static struct wl_list fstack;  /* focus order */
 static struct wlr_idle_notifier_v1 *idle_notifier;
 static struct wlr_idle_inhibit_manager_v1 *idle_inhibit_mgr;
@@ -443,6 +559,17 @@ static struct wl_list mons;
 static Monitor *selmon;
 
 static struct statusbar statusbar;
+static struct collector collector;
+static struct wl_event_source *bar_idle_source;
+static struct wl_event_source *motion_idle_source;
+static uint32_t motiontime; /* of the last motion batched for flushmotion() */
+
+/* keys[] and chords[] hashed by (node, CLEANMASK(mod), keysym), see setupkeys() */
+static Binding *bindings;
+static size_t bindingmask;
+static int chord; /* node of the pending chord prefix, 0 for none */
+static int chordprefix; /* the last key entered a prefix, it must not repeat */
+static struct wl_event_source *chordtimer;
 
 static const struct wlr_buffer_impl buffer_impl = {
     .destroy = buffer_destroy,
@@ -472,6 +599,9 @@ static xcb_atom_t netatom[NetLast];
 static pid_t *autostart_pids;
 static size_t autostart_len;
 
+/* colors decoded once for drawing, see loadcolors() */
+static struct color schemes[LENGTH(colors)][3];
+
 /* function implementations */
 void
 applybounds(Client *c, struct wlr_box *bbox)
@@ -525,7 +655,9 @@ void
 arrange(Monitor *m)
 {
 	Client *c;
+	PROBE_SCOPE("arrange");
 
+	indexgen++;
 	if (!m->wlr_output->enabled)
 		return;
 
@@ -592,6 +724,7 @@ arrangelayers(Monitor *m)
 	};
 	if (!m->wlr_output->enabled)
 		return;
+	scenegen++;
 
 	if (m->scene_buffer->node.enabled) {
 		usable_area.height -= m->b.real_height;
@@ -651,6 +784,11 @@ axisnotify(struct wl_listener *listener, void *data)
 	/* This event is forwarded by the cursor when a pointer emits an axis event,
 	 * for example when you move the scroll wheel. */
 	struct wlr_pointer_axis_event *event = data;
+	/* Clients must see the motion before what follows it */
+	if (motion_idle_source) {
+		wl_event_source_remove(motion_idle_source);
+		flushmotion(NULL);
+	}
 	wlr_idle_notifier_v1_notify_activity(idle_notifier, seat);
 	/* TODO: allow usage of scroll whell for mousebindings, it can be implemented
 	 * checking the event's orientation and the delta of the event */
@@ -666,14 +804,81 @@ bar_accepts_input(struct wlr_scene_buffer *buffer, double *sx, double *sy)
 	return true;
 }
 
+Buffer *
+buffer_acquire(Monitor *m)
+{
+	Buffer **slot, **oldest = NULL;
+
+	for (slot = m->bar_buffers; slot < END(m->bar_buffers); slot++) {
+		if (*slot && ((*slot)->base.width != m->b.width
+				|| (*slot)->base.height != m->b.height)) {
+			wlr_buffer_drop(&(*slot)->base);
+			*slot = NULL;
+		}
+		if (!*slot)
+			return (*slot = buffer_create(m->b.width, m->b.height));
+		if (!(*slot)->busy)
+			return *slot;
+		if (!oldest)
+			oldest = slot;
+	}
+
+	/* Everything is still held by the scene, give up on one of them.
+	 * It is freed as soon as wlroots lets go of it. */
+	wlr_buffer_drop(&(*oldest)->base);
+	return (*oldest = buffer_create(m->b.width, m->b.height));
+}
+
+Buffer *
+buffer_create(int width, int height)
+{
+	Buffer *buf = ecalloc(1, sizeof(*buf));
+
+	buf->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+	buf->size = buf->stride * height;
+	if (!(buf->data = shm_map(buf->size))) {
+		free(buf);
+		return NULL;
+	}
+
+	wlr_buffer_init(&buf->base, &buffer_impl, width, height);
+	LISTEN(&buf->base.events.release, &buf->release, buffer_release);
+	/* Nothing has been copied into it yet */
+	pixman_region32_init_rect(&buf->stale, 0, 0, width, height);
+
+	return buf;
+}
+
 void
 buffer_destroy(struct wlr_buffer *wlr_buffer)
 {
 	Buffer *buf;
 	buf = wl_container_of(wlr_buffer, buf, base);
+	wl_list_remove(&buf->release.link);
+	pixman_region32_fini(&buf->stale);
+	munmap(buf->data, buf->size);
 	free(buf);
 }
 
+void
+buffer_release(struct wl_listener *listener, void *data)
+{
+	Buffer *buf = wl_container_of(listener, buf, release);
+	buf->busy = 0;
+}
+
+void
+buffers_destroy(Monitor *m)
+{
+	Buffer **slot;
+
+	for (slot = m->bar_buffers; slot < END(m->bar_buffers); slot++) {
+		if (*slot)
+			wlr_buffer_drop(&(*slot)->base);
+		*slot = NULL;
+	}
+}
+
 bool
 buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer, uint32_t flags,
                              void **data, uint32_t *format, size_t *stride)
@@ -695,6 +900,39 @@ buffer_end_data_ptr_access(struct wlr_buffer *buffer)
 {
 }
 
+struct wlr_box
+bufferbox(struct wlr_scene_buffer *buffer, int x, int y)
+{
+	/* The destination size is 0 unless it was set, in which case the
+	 * buffer is shown at its own size */
+	struct wlr_box b = {x, y, buffer->dst_width, buffer->dst_height};
+	if (!b.width && buffer->buffer) {
+		b.width = buffer->transform & WL_OUTPUT_TRANSFORM_90
+			? buffer->buffer->height : buffer->buffer->width;
+		b.height = buffer->transform & WL_OUTPUT_TRANSFORM_90
+			? buffer->buffer->width : buffer->buffer->height;
+	}
+	return b;
+}
+
+void
+buildgrid(Monitor *m)
+{
+	size_t i, n;
+
+	memset(m->grid.first, 0, sizeof(m->grid.first));
+	fillgrid(m, 1);
+	for (i = n = 0; i < GRIDSIZE * GRIDSIZE; i++)
+		m->grid.first[i] = n += m->grid.first[i];
+	m->grid.first[i] = n;
+	if (n > m->grid.size) {
+		free(m->grid.c);
+		m->grid.c = ecalloc(m->grid.size = 2 * n, sizeof(*m->grid.c));
+	}
+	fillgrid(m, 0);
+	m->grid.gen = indexgen;
+}
+
 void
 buttonpress(struct wl_listener *listener, void *data)
 {
@@ -704,6 +942,10 @@ buttonpress(struct wl_listener *listener, void *data)
 	Client *c;
 	const Button *b;
 
+	if (motion_idle_source) {
+		wl_event_source_remove(motion_idle_source);
+		flushmotion(NULL);
+	}
 	wlr_idle_notifier_v1_notify_activity(idle_notifier, seat);
 
 	switch (event->state) {
@@ -748,6 +990,54 @@ buttonpress(struct wl_listener *listener, void *data)
 			event->time_msec, event->button, event->state);
 }
 
+void
+cachehit(struct wlr_scene_node *node, int layer, double x, double y,
+		double sx, double sy, struct wlr_surface *surface, Client *c, LayerSurface *l)
+{
+	/* The surface is found again for as long as the pointer stays in the
+	 * same rectangle of its input region and of its scene buffer, and out
+	 * of whatever is stacked above it. Anything that could change that
+	 * bumps scenegen or indexgen, or destroys the node */
+	struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+	pixman_box32_t r;
+	int lx, ly, above = 0, px = (int)floor(x), py = (int)floor(y);
+
+	hit.gen = 0;
+	wl_list_remove(&hit.destroy.link);
+	wl_list_init(&hit.destroy.link);
+
+	hit.x = (int)round(x - sx);
+	hit.y = (int)round(y - sy);
+	if (!wlr_scene_node_coords(node, &lx, &ly)
+			|| !pixman_region32_contains_point(&surface->input_region,
+				px - hit.x, py - hit.y, &r))
+		return;
+	hit.box = bufferbox(buffer, lx, ly);
+	if (!wlr_box_intersection(&hit.box, &hit.box, &(struct wlr_box){hit.x + r.x1,
+			hit.y + r.y1, r.x2 - r.x1, r.y2 - r.y1}))
+		return;
+
+	hit.node = node;
+	for (; layer < NUM_LAYERS; layer++) {
+		if (!cliphit(&layers[layer]->node, 0, 0, px, py, &above))
+			return;
+	}
+
+	hit.surface = surface;
+	hit.c = c;
+	hit.l = l;
+	hit.gen = scenegen;
+	hit.index = indexgen;
+	wl_signal_add(&node->events.destroy, &hit.destroy);
+}
+
+int
+chordexpire(void *data)
+{
+	chord = 0;
+	return 0;
+}
+
 void
 chvt(const Arg *arg)
 {
@@ -775,7 +1065,7 @@ checkidleinhibitor(struct wlr_surface *exclude)
 void
 cleanup(void)
 {
-	size_t i;
+	size_t i, j;
 #ifdef XWAYLAND
 	wlr_xwayland_destroy(xwayland);
 	xwayland = NULL;
@@ -793,8 +1083,10 @@ cleanup(void)
 		waitpid(child_pid, NULL, 0);
 	}
 	wlr_xcursor_manager_destroy(cursor_mgr);
+	collector_stop(&collector);
 
 	destroykeyboardgroup(&kb_group->destroy, NULL);
+	wl_event_source_remove(chordtimer);
 
 	/* If it's not destroyed manually it will cause a use-after-free of wlr_seat.
 	 * Destroy it until it's fixed in the wlroots side */
@@ -804,6 +1096,17 @@ cleanup(void)
 	/* Destroy after the wayland display (when the monitors are already destroyed)
 	   to avoid destroying them with an invalid scene output. */
 	wlr_scene_node_destroy(&scene->tree.node);
+
+	for (i = 0; i < LENGTH(colors); i++) {
+		for (j = 0; j < LENGTH(colors[i]); j++)
+			color_finish(&schemes[i][j]);
+	}
+	free(bindings);
+	stats_stop();
+#ifdef PROBES
+	trace_stop();
+	probe_dump(stdout);
+#endif
 }
 
 void
@@ -819,22 +1122,79 @@ cleanupmon(struct wl_listener *listener, void *data)
 			wlr_layer_surface_v1_destroy(l->layer_surface);
 	}
 
+	buffers_destroy(m);
 	drwl_destroy(m->drw);
 
 	wl_list_remove(&m->destroy.link);
 	wl_list_remove(&m->frame.link);
+	wl_list_remove(&m->present.link);
 	wl_list_remove(&m->link);
 	wl_list_remove(&m->request_state.link);
 	m->wlr_output->data = NULL;
 	wlr_output_layout_remove(output_layout, m->wlr_output);
 	wlr_scene_output_destroy(m->scene_output);
+#ifdef PROBES
+	trace_track_release(m->trace_track);
+#endif
 
 	closemon(m);
 	wlr_scene_node_destroy(&m->fullscreen_bg->node);
 	wlr_scene_node_destroy(&m->scene_buffer->node);
+	free(m->grid.c);
 	free(m);
 }
 
+int
+cliphit(struct wlr_scene_node *node, int lx, int ly, int px, int py, int *above)
+{
+	/* Shrink hit.box to keep it clear of the nodes stacked above hit.node,
+	 * in the order they are rendered. Returns 0 if the pointer is on one
+	 * of them, which only lets it through outside of its input region */
+	struct wlr_scene_node *child;
+	struct wlr_box b, unused;
+
+	if (!node->enabled)
+		return 1;
+	lx += node->x;
+	ly += node->y;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		wl_list_for_each(child, &wlr_scene_tree_from_node(node)->children, link) {
+			if (!cliphit(child, lx, ly, px, py, above))
+				return 0;
+		}
+		return 1;
+	}
+	if (node == hit.node)
+		*above = 1;
+	if (node == hit.node || !*above)
+		return 1;
+
+	if (node->type == WLR_SCENE_NODE_RECT)
+		b = (struct wlr_box){lx, ly, wlr_scene_rect_from_node(node)->width,
+				wlr_scene_rect_from_node(node)->height};
+	else
+		b = bufferbox(wlr_scene_buffer_from_node(node), lx, ly);
+	if (!wlr_box_intersection(&unused, &b, &hit.box))
+		return 1;
+
+	/* keep the side of the node the pointer is on */
+	if (px < b.x) {
+		hit.box.width = b.x - hit.box.x;
+	} else if (px >= b.x + b.width) {
+		hit.box.width -= b.x + b.width - hit.box.x;
+		hit.box.x = b.x + b.width;
+	} else if (py < b.y) {
+		hit.box.height = b.y - hit.box.y;
+	} else if (py >= b.y + b.height) {
+		hit.box.height -= b.y + b.height - hit.box.y;
+		hit.box.y = b.y + b.height;
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
 void
 closemon(Monitor *m)
 {
@@ -939,6 +1299,7 @@ commitpopup(struct wl_listener *listener, void *data)
 	struct wlr_xdg_popup *popup = wlr_xdg_popup_try_from_wlr_surface(surface);
 	LayerSurface *l = NULL;
 	Client *c = NULL;
+	Popup *p;
 	struct wlr_box box;
 	int type = -1;
 
@@ -950,6 +1311,12 @@ commitpopup(struct wl_listener *listener, void *data)
 		return;
 	popup->base->surface->data = wlr_scene_xdg_surface_create(
 			popup->parent->data, popup->base);
+	if (c) {
+		p = ecalloc(1, sizeof(*p));
+		p->popup = popup;
+		wl_list_insert(&popups, &p->link);
+		LISTEN(&popup->base->events.destroy, &p->destroy, destroypopup);
+	}
 	if ((l && !l->mon) || (c && !c->mon))
 		return;
 	box = type == LayerShell ? l->mon->m : c->mon->w;
@@ -959,6 +1326,51 @@ commitpopup(struct wl_listener *listener, void *data)
 	wl_list_remove(&listener->link);
 }
 
+void
+commitsurface(struct wl_listener *listener, void *data)
+{
+	/* Every client change to the scene arrives here. Most commits only
+	 * bring new content, which leaves the hit cache alone; those that
+	 * map, unmap, resize or move a surface, move or restack its
+	 * subsurfaces or set its input region invalidate it */
+	SurfaceListener *l = wl_container_of(listener, l, commit);
+	struct wlr_surface *surface = data;
+	struct wlr_subsurface_parent_state *sub;
+	struct wlr_xdg_surface *xdg;
+	struct wlr_box place = {0, 0, surface->current.width, surface->current.height};
+	uint32_t hash;
+
+	/* not part of the scene, e.g. cursors and drag icons */
+	if (!wlr_surface_get_root_surface(surface)->data)
+		return;
+
+	if ((xdg = wlr_xdg_surface_try_from_wlr_surface(surface))) {
+		place.x = xdg->geometry.x;
+		place.y = xdg->geometry.y;
+		if (xdg->role == WLR_XDG_SURFACE_ROLE_POPUP && xdg->popup) {
+			place.x -= xdg->popup->current.geometry.x;
+			place.y -= xdg->popup->current.geometry.y;
+		}
+	}
+	hash = drwl_hash(DRWL_HASH_INIT, &place, sizeof(place));
+	/* subsurfaces are placed by the commits of their parent, which is
+	 * stacked between those below and those above it */
+	wl_list_for_each(sub, &surface->current.subsurfaces_below, link) {
+		hash = drwl_hash(hash, &sub, sizeof(sub));
+		hash = drwl_hash(hash, &sub->x, sizeof(sub->x));
+		hash = drwl_hash(hash, &sub->y, sizeof(sub->y));
+	}
+	hash = drwl_hash(hash, &surface, sizeof(surface));
+	wl_list_for_each(sub, &surface->current.subsurfaces_above, link) {
+		hash = drwl_hash(hash, &sub, sizeof(sub));
+		hash = drwl_hash(hash, &sub->x, sizeof(sub->x));
+		hash = drwl_hash(hash, &sub->y, sizeof(sub->y));
+	}
+	if (hash != l->hash || surface->current.committed & WLR_SURFACE_STATE_INPUT_REGION)
+		scenegen++;
+	l->hash = hash;
+}
+
 void
 createdecoration(struct wl_listener *listener, void *data)
 {
@@ -1125,6 +1537,10 @@ createmon(struct wl_listener *listener, void *data)
 
 	/* Set up event listeners */
 	LISTEN(&wlr_output->events.frame, &m->frame, rendermon);
+	LISTEN(&wlr_output->events.present, &m->present, presentmon);
+#ifdef PROBES
+	m->trace_track = trace_track(wlr_output->name);
+#endif
 	LISTEN(&wlr_output->events.destroy, &m->destroy, cleanupmon);
 	LISTEN(&wlr_output->events.request_state, &m->request_state, requestmonstate);
 
@@ -1133,7 +1549,7 @@ createmon(struct wl_listener *listener, void *data)
 	wlr_output_state_finish(&state);
 
 	// why do we not seperate these, this is far more clear.
-	m->drw = drwl_create(font);
+	m->drw = drwl_create(font, wlr_output->scale, fasttext);
 	if (!m->drw) {
 		die("failed to create drwl context");
 	}
@@ -1253,6 +1669,16 @@ createpopup(struct wl_listener *listener, void *data)
 	LISTEN_STATIC(&popup->base->surface->events.commit, commitpopup);
 }
 
+void
+createsurface(struct wl_listener *listener, void *data)
+{
+	struct wlr_surface *surface = data;
+	SurfaceListener *l = ecalloc(1, sizeof(*l));
+
+	LISTEN(&surface->events.commit, &l->commit, commitsurface);
+	LISTEN(&surface->events.destroy, &l->destroy, destroysurface);
+}
+
 void
 cursorconstrain(struct wlr_pointer_constraint_v1 *constraint)
 {
@@ -1273,8 +1699,10 @@ cursorframe(struct wl_listener *listener, void *data)
 	 * event. Frame events are sent after regular pointer events to group
 	 * multiple events together. For instance, two axis events may happen at the
 	 * same time, in which case a frame event won't be sent in between. */
-	/* Notify the client with pointer focus of the frame event. */
-	wlr_seat_pointer_notify_frame(seat);
+	/* Notify the client with pointer focus of the frame event, unless
+	 * flushmotion() is still to send the motion it ends */
+	if (!motion_idle_source)
+		wlr_seat_pointer_notify_frame(seat);
 }
 
 void
@@ -1309,6 +1737,14 @@ destroydragicon(struct wl_listener *listener, void *data)
 	motionnotify(0, NULL, 0, 0, 0, 0);
 }
 
+void
+destroyhit(struct wl_listener *listener, void *data)
+{
+	hit.gen = 0;
+	wl_list_remove(&hit.destroy.link);
+	wl_list_init(&hit.destroy.link);
+}
+
 void
 destroyidleinhibitor(struct wl_listener *listener, void *data)
 {
@@ -1338,6 +1774,7 @@ destroylock(SessionLock *lock, int unlock)
 	if ((locked = !unlock))
 		goto destroy;
 
+	scenegen++;
 	wlr_scene_node_set_enabled(&locked_bg->node, 0);
 
 	focusclient(focustop(selmon), 0);
@@ -1414,6 +1851,16 @@ destroypointerconstraint(struct wl_listener *listener, void *data)
 	free(pointer_constraint);
 }
 
+void
+destroypopup(struct wl_listener *listener, void *data)
+{
+	Popup *p = wl_container_of(listener, p, destroy);
+
+	wl_list_remove(&p->link);
+	wl_list_remove(&p->destroy.link);
+	free(p);
+}
+
 void
 destroysessionlock(struct wl_listener *listener, void *data)
 {
@@ -1428,6 +1875,16 @@ destroysessionmgr(struct wl_listener *listener, void *data)
 	wl_list_remove(&listener->link);
 }
 
+void
+destroysurface(struct wl_listener *listener, void *data)
+{
+	SurfaceListener *l = wl_container_of(listener, l, destroy);
+
+	wl_list_remove(&l->commit.link);
+	wl_list_remove(&l->destroy.link);
+	free(l);
+}
+
 void
 destroykeyboardgroup(struct wl_listener *listener, void *data)
 {
@@ -1459,106 +1916,97 @@ dirtomon(enum wlr_direction dir)
 void
 drawbar(Monitor *m)
 {
-	static uint32_t *color = colors[SchemeNorm];
-	int x, w, tw = 0;
-	int boxs = m->drw->font->height / 9;
-	int boxw = m->drw->font->height / 6 + 2;
-	uint32_t i, occ = 0, urg = 0;
-	int32_t stride, size;
-	Client *c;
-	Buffer *buf;
-
-	if (!m->scene_buffer->node.enabled)
-		return;
-
-	stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, m->b.width);
-	size = stride * m->b.height;
+	/* Only mark the bar, it is redrawn once the event loop goes idle
+	 * so that several changes in a row cost a single redraw */
+	m->bar_dirty = 1;
+	if (!bar_idle_source)
+		bar_idle_source = wl_event_loop_add_idle(event_loop, flushbars, NULL);
+}
 
-	buf = ecalloc(1, sizeof(Buffer) + size);
-	buf->stride = stride;
-	wlr_buffer_init(&buf->base, &buffer_impl, m->b.width, m->b.height);
+void
+drawbars(void)
+{
+	Monitor *m = NULL;
 
-	drwl_prepare_drawing(m->drw, m->b.width, m->b.height, stride, (unsigned char *)buf->data);
+	wl_list_for_each(m, &mons, link)
+		drawbar(m);
+}
 
-	c = focustop(m);
-	m->drw->scheme = colors[m == selmon ? SchemeSel : SchemeNorm];
-	set_color(m->drw->context, m->drw->scheme[ColBg]);
-	if (c) {
-		filled_rect(m->drw->context, 0, 0, m->b.width, m->b.height);
-	}
+void
+dumpframes(FILE *file)
+{
+	Monitor *m;
+	wl_list_for_each(m, &mons, link)
+		frame_stats_dump(file, m->wlr_output->name, &m->frames);
+}
 
-	if (m == selmon) { /* status is only drawn on selected monitor */
-		m->drw->scheme = color;
-		// this renders left to right
-		// yes this is kinda backwards but it makes sense to me
-		tw = draw_system_info(m->drw, &statusbar.system_info, m->b.width, 0);
-		tw = m->b.width - tw;
-	}
+void
+fillgrid(Monitor *m, int count)
+{
+	/* Walk the visible clients bottom to top, counting them in each cell
+	 * of m they overlap or, once m->grid.first holds where each cell ends,
+	 * filling the cells from their end */
+	static const int clientlayers[] = { LyrTile, LyrFloat, LyrFS };
+	struct wlr_scene_node *node;
+	struct wlr_box box;
+	Client *c;
+	size_t i;
+	int x, y;
 
-	wl_list_for_each(c, &clients, link) {
-		if (c->mon != m)
-			continue;
-		occ |= c->tags;
-		if (c->isurgent)
-			urg |= c->tags;
-	}
-
-	x = 0;
-	c = focustop(m);
-	for (i = 0; i < LENGTH(tags); i++) {
-		int flag = m->tagset[m->seltags] & 1 << i;
-		w = TEXTW(m, tags[i]);
-		m->drw->scheme = colors[flag ? SchemeSel : SchemeNorm];
-		flag = urg & 1 << i;
-		set_color(m->drw->context, m->drw->scheme[!flag ? ColBg : ColFg]);
-		filled_rect(m->drw->context, x, 0, w, m->b.height);
-		set_color(m->drw->context, m->drw->scheme[flag ? ColBg : ColFg]);
-		render_text(m->drw->context, m->drw->font, x + m->lrpad / 2, 0, tags[i]);
-
-		if (occ & 1 << i) {
-			int clr_flag = urg & 1 << i ? ColBg : ColFg;
-			set_color(m->drw->context, m->drw->scheme[clr_flag]);
-			if (m == selmon && c && c->tags & 1 << i) {
-				filled_rect(m->drw->context, x + boxs, boxs, boxw, boxw);
-			} else {
-				delineate_rect(m->drw->context, x + boxs, boxs, boxw, boxw);
+	for (i = 0; i < LENGTH(clientlayers); i++) {
+		wl_list_for_each(node, &layers[clientlayers[i]]->children, link) {
+			/* fullscreen_bg has no data */
+			if (!node->enabled || !(c = node->data)
+					|| !wlr_box_intersection(&box, &c->geom, &m->m))
+				continue;
+			for (y = GRIDROW(m, box.y); y <= GRIDROW(m, box.y + box.height - 1); y++) {
+				for (x = GRIDCOL(m, box.x); x <= GRIDCOL(m, box.x + box.width - 1); x++) {
+					if (count)
+						m->grid.first[y * GRIDSIZE + x]++;
+					else
+						m->grid.c[--m->grid.first[y * GRIDSIZE + x]] = c;
+				}
 			}
 		}
-		x += w;
 	}
+}
 
-	w = m->b.width - x;
-
-	if (w > m->b.height) {
-		if (c) {
-			m->drw->scheme = colors[m == selmon ? SchemeSel : SchemeNorm];
-			color = colors[m == selmon ? SchemeSel : SchemeNorm];
-			set_color(m->drw->context, m->drw->scheme[ColFg]);
-			render_text(m->drw->context, m->drw->font, x + m->lrpad / 2, 0, client_get_title(c));
-		} else {
-			m->drw->scheme = colors[SchemeNorm];
-			color = colors[SchemeNorm];
-			set_color(m->drw->context, color[ColBg]);
-			delineate_rect(m->drw->context, x, 0, w, m->b.height);
-		}
+Binding *
+findbinding(int node, uint32_t mods, xkb_keysym_t sym)
+{
+	/* the binding, or the free slot it would go in */
+	size_t i;
+	for (i = keyhash(node, mods, sym) & bindingmask; bindings[i].keysym != XKB_KEY_NoSymbol;
+			i = (i + 1) & bindingmask) {
+		if (bindings[i].node == node && bindings[i].keysym == sym
+				&& CLEANMASK(bindings[i].mod) == CLEANMASK(mods))
+			break;
 	}
-
-	drwl_finish_drawing(m->drw);
-	wlr_scene_buffer_set_dest_size(m->scene_buffer,
-		m->b.real_width, m->b.real_height);
-	wlr_scene_node_set_position(&m->scene_buffer->node, m->m.x,
-		m->m.y + (topbar ? 0 : m->m.height - m->b.real_height));
-	wlr_scene_buffer_set_buffer(m->scene_buffer, &buf->base);
-	wlr_buffer_drop(&buf->base);
+	return &bindings[i];
 }
 
 void
-drawbars(void)
+flushbars(void *data)
 {
-	Monitor *m = NULL;
+	Monitor *m;
 
-	wl_list_for_each(m, &mons, link)
-		drawbar(m);
+	/* Idle sources fire once and are removed by the event loop */
+	bar_idle_source = NULL;
+	wl_list_for_each(m, &mons, link) {
+		if (!m->bar_dirty)
+			continue;
+		m->bar_dirty = 0;
+		renderbar(m);
+	}
+}
+
+void
+flushmotion(void *data)
+{
+	/* Idle sources fire once and are removed by the event loop */
+	motion_idle_source = NULL;
+	motionnotify(motiontime, NULL, 0, 0, 0, 0);
+	wlr_seat_pointer_notify_frame(seat);
 }
 
 void
@@ -1568,13 +2016,16 @@ focusclient(Client *c, int lift)
 	int unused_lx, unused_ly, old_client_type;
 	Client *old_c = NULL;
 	LayerSurface *old_l = NULL;
+	PROBE_SCOPE("focusclient");
 
 	if (locked)
 		return;
 
 	/* Raise client in stacking order if requested */
-	if (c && lift)
+	if (c && lift) {
 		wlr_scene_node_raise_to_top(&c->scene->node);
+		indexgen++;
+	}
 
 	if (c && client_surface(c) == old)
 		return;
@@ -1596,7 +2047,7 @@ focusclient(Client *c, int lift)
 		/* Don't change border color if there is an exclusive focus or we are
 		 * handling a drag operation */
 		if (!exclusive_focus && !seat->drag)
-			client_set_border_color(c, (float[])COLOR(colors[SchemeSel][ColBorder]));
+			client_set_border_color(c, schemes[SchemeSel][ColBorder].rgba);
 	}
 
 	/* Deactivate old client if focus is changing */
@@ -1613,7 +2064,7 @@ focusclient(Client *c, int lift)
 		/* Don't deactivate old client if the new one wants focus, as this causes issues with winecfg
 		 * and probably other clients */
 		} else if (old_c && !client_is_unmanaged(old_c) && (!c || !client_wants_focus(c))) {
-			client_set_border_color(old_c, (float[])COLOR(colors[SchemeNorm][ColBorder]));
+			client_set_border_color(old_c, schemes[SchemeNorm][ColBorder].rgba);
 			client_activate_surface(old, 0);
 		}
 	}
@@ -1736,6 +2187,9 @@ handlesig(int signo)
 			waitpid(in.si_pid, NULL, 0);
 			if (in.si_pid == child_pid) {
 				child_pid = -1;
+				/* e.g. benchmark runs end with their client */
+				if (exitwithchild)
+					quit(NULL);
 			}
 
 			if (!(p = autostart_pids)) {
@@ -1803,15 +2257,38 @@ keybinding(uint32_t mods, xkb_keysym_t sym)
 	 * processing keys, rather than passing them on to the client for its own
 	 * processing.
 	 */
-	const Key *k;
-	for (k = keys; k < END(keys); k++) {
-		if (CLEANMASK(mods) == CLEANMASK(k->mod)
-				&& sym == k->keysym && k->func) {
-			k->func(&k->arg);
-			return 1;
-		}
+	Binding *b;
+
+	/* modifiers on their own neither advance nor end a chord */
+	if (chord && sym >= XKB_KEY_Shift_L && sym <= XKB_KEY_Hyper_R)
+		return 0;
+
+	b = findbinding(chord, mods, sym);
+	if (b->keysym == XKB_KEY_NoSymbol && chord) {
+		/* any other key cancels the chord, and is handled as if there
+		 * had been none, so typing right after a mode isn't lost */
+		setchord(0);
+		b = findbinding(0, mods, sym);
 	}
-	return 0;
+	if (b->keysym == XKB_KEY_NoSymbol)
+		return 0;
+
+	chordprefix = b->next != 0;
+	if (b->next) {
+		setchord(b->next);
+		return 1;
+	}
+	/* a mode stays at its prefix, so the binding can be pressed again */
+	setchord(b->mode ? chord : 0);
+	b->func(b->arg);
+	return 1;
+}
+
+uint32_t
+keyhash(int node, uint32_t mods, xkb_keysym_t sym)
+{
+	uint32_t h = (sym ^ CLEANMASK(mods) << 24 ^ (uint32_t)node << 16) * 2654435761u;
+	return h ^ h >> 16;
 }
 
 void
@@ -1833,6 +2310,7 @@ keypress(struct wl_listener *listener, void *data)
 	uint32_t mods = wlr_keyboard_get_modifiers(&group->wlr_group->keyboard);
 
 	wlr_idle_notifier_v1_notify_activity(idle_notifier, seat);
+	TRACE_INSTANT("key", event->keycode);
 
 	/* On _press_ if there is no active screen locker,
 	 * attempt to process a compositor keybinding. */
@@ -1841,7 +2319,7 @@ keypress(struct wl_listener *listener, void *data)
 			handled = keybinding(mods, syms[i]) || handled;
 	}
 
-	if (handled && group->wlr_group->keyboard.repeat_info.delay > 0) {
+	if (handled && !chordprefix && group->wlr_group->keyboard.repeat_info.delay > 0) {
 		group->mods = mods;
 		group->keysyms = syms;
 		group->nsyms = nsyms;
@@ -1899,11 +2377,27 @@ killclient(const Arg *arg)
 		client_send_close(sel);
 }
 
+void
+loadcolors(void)
+{
+	size_t i, j;
+
+	/* Everything that draws a scheme reads it from here, so reloading
+	 * the colors only means calling this again and redrawing */
+	for (i = 0; i < LENGTH(colors); i++) {
+		for (j = 0; j < LENGTH(colors[i]); j++) {
+			color_finish(&schemes[i][j]);
+			color_init(&schemes[i][j], colors[i][j]);
+		}
+	}
+}
+
 void
 locksession(struct wl_listener *listener, void *data)
 {
 	struct wlr_session_lock_v1 *session_lock = data;
 	SessionLock *lock;
+	scenegen++;
 	wlr_scene_node_set_enabled(&locked_bg->node, 1);
 	if (cur_lock) {
 		wlr_session_lock_v1_destroy(session_lock);
@@ -1931,6 +2425,8 @@ mapnotify(struct wl_listener *listener, void *data)
 	Client *w, *c = wl_container_of(listener, c, map);
 	Monitor *m;
 	int i;
+	TRACE_INSTANT("map", 0);
+	indexgen++;
 
 	/* Create scene tree for this client and its border */
 	c->scene = client_surface(c)->data = wlr_scene_tree_create(layers[LyrTile]);
@@ -1956,7 +2452,7 @@ mapnotify(struct wl_listener *listener, void *data)
 
 	for (i = 0; i < 4; i++) {
 		c->border[i] = wlr_scene_rect_create(c->scene, 0, 0,
-			(float[])COLOR(colors[c->isurgent ? SchemeUrg : SchemeNorm][ColBorder]));
+			schemes[c->isurgent ? SchemeUrg : SchemeNorm][ColBorder].rgba);
 		c->border[i]->node.data = c;
 	}
 
@@ -2055,11 +2551,17 @@ motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double d
 	LayerSurface *l = NULL;
 	struct wlr_surface *surface = NULL;
 	struct wlr_pointer_constraint_v1 *constraint;
+	/* Pointers can report motion far more often than the scene changes.
+	 * With batchmotion, motion events only move the cursor, and the rest
+	 * is done once the event loop goes idle, by flushmotion() calling
+	 * back here without a device */
+	int batched = batchmotion && time && device;
 
 	/* Find the client under the pointer and send the event along. */
-	xytonode(cursor->x, cursor->y, &surface, &c, NULL, &sx, &sy);
+	if (!batched)
+		xytonode(cursor->x, cursor->y, &surface, &c, NULL, &sx, &sy);
 
-	if (cursor_mode == CurPressed && !seat->drag
+	if (!batched && cursor_mode == CurPressed && !seat->drag
 			&& surface != seat->pointer_state.focused_surface
 			&& toplevel_from_wlr_surface(seat->pointer_state.focused_surface, &w, &l) >= 0) {
 		c = w;
@@ -2070,12 +2572,16 @@ motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double d
 
 	/* time is 0 in internal calls meant to restore pointer focus. */
 	if (time) {
-		wlr_relative_pointer_manager_v1_send_relative_motion(
-				relative_pointer_mgr, seat, (uint64_t)time * 1000,
-				dx, dy, dx_unaccel, dy_unaccel);
-
-		wl_list_for_each(constraint, &pointer_constraints->constraints, link)
-			cursorconstrain(constraint);
+		/* the batched events were sent on already */
+		if (device)
+			wlr_relative_pointer_manager_v1_send_relative_motion(
+					relative_pointer_mgr, seat, (uint64_t)time * 1000,
+					dx, dy, dx_unaccel, dy_unaccel);
+
+		if (!batched) {
+			wl_list_for_each(constraint, &pointer_constraints->constraints, link)
+				cursorconstrain(constraint);
+		}
 
 		if (active_constraint && cursor_mode != CurResize && cursor_mode != CurMove) {
 			toplevel_from_wlr_surface(active_constraint->surface, &c, NULL);
@@ -2094,6 +2600,12 @@ motionnotify(uint32_t time, struct wlr_input_device *device, double dx, double d
 		}
 
 		wlr_cursor_move(cursor, device, dx, dy);
+		if (batched) {
+			motiontime = time;
+			if (!motion_idle_source)
+				motion_idle_source = wl_event_loop_add_idle(event_loop, flushmotion, NULL);
+			return;
+		}
 		wlr_idle_notifier_v1_notify_activity(idle_notifier, seat);
 
 		/* Update selmon (even while dragging a window) */
@@ -2168,6 +2680,32 @@ moveresize(const Arg *arg)
 	}
 }
 
+struct wlr_scene_node *
+nodeat(int layer, double x, double y, double *nx, double *ny)
+{
+	/* Rather than walking every client in a layer, only those in the grid
+	 * cell of the point are tried, top to bottom. The grid goes by c->geom,
+	 * which popups can reach out of, so it is not used on top of one */
+	struct wlr_scene_node *node;
+	Monitor *m;
+	size_t i, end;
+	int cell;
+
+	if ((layer != LyrTile && layer != LyrFloat && layer != LyrFS)
+			|| popupat(x, y) || !(m = xytomon(x, y)))
+		return wlr_scene_node_at(&layers[layer]->node, x, y, nx, ny);
+
+	if (m->grid.gen != indexgen)
+		buildgrid(m);
+	cell = GRIDROW(m, (int)floor(y)) * GRIDSIZE + GRIDCOL(m, (int)floor(x));
+	for (i = m->grid.first[cell], end = m->grid.first[cell + 1]; i < end; i++) {
+		node = &m->grid.c[i]->scene->node;
+		if (node->parent == layers[layer] && (node = wlr_scene_node_at(node, x, y, nx, ny)))
+			return node;
+	}
+	return NULL;
+}
+
 void
 outputmgrapply(struct wl_listener *listener, void *data)
 {
@@ -2274,6 +2812,29 @@ pointerfocus(Client *c, struct wlr_surface *surface, double sx, double sy,
 }
 
 
+int
+popupat(double x, double y)
+{
+	/* Whether one of the popups of clients, including its subsurfaces, is
+	 * at x, y. Wherever their client is, popups can reach any output */
+	Popup *p;
+	struct wlr_scene_tree *tree;
+	struct wlr_box box;
+	int lx, ly;
+
+	wl_list_for_each(p, &popups, link) {
+		if (!(tree = p->popup->base->surface->data)
+				|| !wlr_scene_node_coords(&tree->node, &lx, &ly))
+			continue;
+		wlr_surface_get_extents(p->popup->base->surface, &box);
+		box.x += lx - p->popup->base->geometry.x;
+		box.y += ly - p->popup->base->geometry.y;
+		if (wlr_box_contains_point(&box, x, y))
+			return 1;
+	}
+	return 0;
+}
+
 void
 powermgrsetmode(struct wl_listener *listener, void *data)
 {
@@ -2291,12 +2852,101 @@ powermgrsetmode(struct wl_listener *listener, void *data)
 	m->asleep = !event->mode;
 }
 
+void
+presentmon(struct wl_listener *listener, void *data)
+{
+	Monitor *m = wl_container_of(listener, m, present);
+	struct wlr_output_event_present *event = data;
+
+	frame_presented(&m->frames, event->commit_seq, event->presented, event->when);
+}
+
 void
 quit(const Arg *arg)
 {
 	wl_display_terminate(dpy);
 }
 
+void
+renderbar(Monitor *m)
+{
+	uint32_t i;
+	int32_t stride, y;
+	int nboxes;
+	unsigned char *pixels;
+	Client *c;
+	Buffer *buf;
+	pixman_box32_t *box;
+	pixman_region32_t damage;
+	struct bar_state bar = {
+		.tags = tags, .tag_count = LENGTH(tags),
+		.tagset = m->tagset[m->seltags], .selected = m == selmon,
+		.lrpad = m->lrpad,
+		.norm = schemes[SchemeNorm], .sel = schemes[SchemeSel],
+	};
+	PROBE_SCOPE("renderbar");
+
+	if (!m->scene_buffer->node.enabled)
+		return;
+
+	wl_list_for_each(c, &clients, link) {
+		if (c->mon != m)
+			continue;
+		bar.occupied |= c->tags;
+		if (c->isurgent)
+			bar.urgent |= c->tags;
+	}
+	if ((c = focustop(m))) {
+		bar.client = c;
+		if (!(bar.title = client_get_title(c)))
+			bar.title = "";
+		if (m == selmon)
+			bar.focused = c->tags;
+	}
+
+	drwl_draw_bar(m->drw, &statusbar.system_info, &bar, m->b.width, m->b.height);
+	wlr_scene_buffer_set_dest_size(m->scene_buffer,
+		m->b.real_width, m->b.real_height);
+	wlr_scene_node_set_position(&m->scene_buffer->node, m->m.x,
+		m->m.y + (topbar ? 0 : m->m.height - m->b.real_height));
+
+	/* Nothing changed, keep showing the previous buffer */
+	if (!m->drw->damage_count)
+		return;
+
+	pixman_region32_init(&damage);
+	for (i = 0; i < (uint32_t)m->drw->damage_count; i++)
+		pixman_region32_union_rect(&damage, &damage,
+				m->drw->damage[i].x, 0, m->drw->damage[i].width, m->b.height);
+
+	/* m->drw won't report this damage again, so every buffer lags
+	 * behind by it, even if none of them can be drawn to now */
+	for (i = 0; i < LENGTH(m->bar_buffers); i++) {
+		if (m->bar_buffers[i])
+			pixman_region32_union(&m->bar_buffers[i]->stale,
+					&m->bar_buffers[i]->stale, &damage);
+	}
+
+	if (!(buf = buffer_acquire(m))) {
+		pixman_region32_fini(&damage);
+		return;
+	}
+
+	stride = cairo_image_surface_get_stride(m->drw->surface);
+	pixels = cairo_image_surface_get_data(m->drw->surface);
+	box = pixman_region32_rectangles(&buf->stale, &nboxes);
+	for (; nboxes > 0; nboxes--, box++) {
+		for (y = box->y1; y < box->y2; y++)
+			memcpy((unsigned char *)buf->data + y * buf->stride + box->x1 * 4,
+					pixels + y * stride + box->x1 * 4, (box->x2 - box->x1) * 4);
+	}
+	pixman_region32_clear(&buf->stale);
+
+	buf->busy = 1;
+	wlr_scene_buffer_set_buffer_with_damage(m->scene_buffer, &buf->base, &damage);
+	pixman_region32_fini(&damage);
+}
+
 void
 rendermon(struct wl_listener *listener, void *data)
 {
@@ -2307,12 +2957,20 @@ rendermon(struct wl_listener *listener, void *data)
 	struct wlr_output_state pending = {0};
 	struct wlr_gamma_control_v1 *gamma_control;
 	struct timespec now;
+	struct frame_record *frame = frame_begin(&m->frames);
+	uint64_t commit_start;
+	int ok;
 
 	/* Render if no XDG clients have an outstanding resize and are visible on
 	 * this monitor. */
 	wl_list_for_each(c, &clients, link) {
-		if (c->resize && !c->isfloating && client_is_rendered_on_mon(c, m) && !client_is_stopped(c))
+		if (c->resize && !c->isfloating && client_is_rendered_on_mon(c, m) && !client_is_stopped(c)) {
+			frame_skipped(&m->frames, frame, client_get_appid(c));
+#ifdef PROBES
+			trace_instant("skip", m->trace_track, 0);
+#endif
 			goto skip;
+		}
 	}
 
 	/*
@@ -2328,19 +2986,35 @@ rendermon(struct wl_listener *listener, void *data)
 				= wlr_gamma_control_manager_v1_get_control(gamma_control_mgr, m->wlr_output);
 		m->gamma_lut_changed = 0;
 
-		if (!wlr_gamma_control_v1_apply(gamma_control, &pending))
+		if (!wlr_gamma_control_v1_apply(gamma_control, &pending)) {
+			m->frames.gamma_fallbacks++;
 			goto commit;
+		}
 
 		if (!wlr_output_test_state(m->wlr_output, &pending)) {
 			wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
+			m->frames.gamma_fallbacks++;
 			goto commit;
 		}
-		wlr_output_commit_state(m->wlr_output, &pending);
+		commit_start = frame_now();
+		ok = wlr_output_commit_state(m->wlr_output, &pending);
+		frame_committed(&m->frames, frame, commit_start, m->wlr_output->commit_seq, ok);
 		wlr_output_schedule_frame(m->wlr_output);
 	} else {
 commit:
-		wlr_scene_output_commit(m->scene_output, NULL);
+		/* wlr_scene_output_commit() succeeds without committing anything
+		 * when there is no damage, which must not count as a frame */
+		if (!wlr_scene_output_needs_frame(m->scene_output)) {
+			frame_idle(&m->frames, frame);
+			goto skip;
+		}
+		commit_start = frame_now();
+		ok = wlr_scene_output_commit(m->scene_output, NULL);
+		frame_committed(&m->frames, frame, commit_start, m->wlr_output->commit_seq, ok);
 	}
+#ifdef PROBES
+	trace_span("commit", m->trace_track, commit_start, frame_now(), m->wlr_output->commit_seq);
+#endif
 
 skip:
 	/* Let clients know a frame has been rendered */
@@ -2386,6 +3060,7 @@ resize(Client *c, struct wlr_box geo, int interact)
 
 	if (!c->mon || !client_surface(c)->mapped)
 		return;
+	indexgen++;
 
 	bbox = interact ? &sgeom : &c->mon->w;
 
@@ -2419,6 +3094,12 @@ run(char *startup_cmd)
 	if (!socket)
 		die("startup: display_add_socket_auto");
 	setenv("WAYLAND_DISPLAY", socket, 1);
+	stats_add(dumpframes);
+#ifdef PROBES
+	stats_add(probe_dump);
+#endif
+	if (stats_start(event_loop, socket))
+		fprintf(stderr, "failed to serve stats, SIGUSR1 still prints them\n");
 
 	/* Start the backend. This will enumerate outputs and inputs, become the DRM
 	 * master, etc */
@@ -2458,6 +3139,16 @@ run(char *startup_cmd)
 	wl_display_run(dpy);
 }
 
+void
+setchord(int node)
+{
+	if (!node && !chord)
+		return;
+	chord = node;
+	/* the timeout restarts with every key of the chord */
+	wl_event_source_timer_update(chordtimer, node ? chordtimeout : 0);
+}
+
 void
 setcursor(struct wl_listener *listener, void *data)
 {
@@ -2632,6 +3323,10 @@ setup(void)
 	 * clients from the Unix socket, manging Wayland globals, and so on. */
 	dpy = wl_display_create();
 	event_loop = wl_display_get_event_loop(dpy);
+#ifdef PROBES
+	if (getenv("DWL_TRACE") && trace_start(event_loop, getenv("DWL_TRACE")))
+		fprintf(stderr, "failed to start tracing\n");
+#endif
 
 	/* The backend is a wlroots feature which abstracts the underlying input and
 	 * output hardware. The autocreate option will choose the most suitable
@@ -2647,6 +3342,8 @@ setup(void)
 		layers[i] = wlr_scene_tree_create(&scene->tree);
 	drag_icon = wlr_scene_tree_create(&scene->tree);
 	wlr_scene_node_place_below(&drag_icon->node, &layers[LyrBlock]->node);
+	hit.destroy.notify = destroyhit;
+	wl_list_init(&hit.destroy.link);
 
 	/* Autocreates a renderer, either Pixman, GLES2 or Vulkan for us. The user
 	 * can also specify a renderer using the WLR_RENDERER env var.
@@ -2683,6 +3380,7 @@ setup(void)
 	 * the clients cannot set the selection directly without compositor approval,
 	 * see the setsel() function. */
 	compositor = wlr_compositor_create(dpy, 6, drw);
+	LISTEN_STATIC(&compositor->events.new_surface, createsurface);
 	wlr_subcompositor_create(dpy);
 	wlr_data_device_manager_create(dpy);
 	wlr_export_dmabuf_manager_v1_create(dpy);
@@ -2723,6 +3421,7 @@ setup(void)
 	 * https://drewdevault.com/2018/07/29/Wayland-shells.html
 	 */
 	wl_list_init(&clients);
+	wl_list_init(&popups);
 	wl_list_init(&fstack);
 
 	xdg_shell = wlr_xdg_shell_create(dpy, 6);
@@ -2815,8 +3514,12 @@ setup(void)
 	LISTEN_STATIC(&output_mgr->events.apply, outputmgrapply);
 	LISTEN_STATIC(&output_mgr->events.test, outputmgrtest);
 
-	statusbar.timed_event_source = wl_event_loop_add_timer(event_loop, status_in, &statusbar);
-	wl_event_source_timer_update(statusbar.timed_event_source, 45000);
+	loadcolors();
+	setupkeys();
+
+	/* The status is refreshed whenever the kernel reports a change */
+	if (collector_start(&collector, event_loop, &statusbar.system_info, status_in, NULL))
+		fprintf(stderr, "failed to listen for some status changes\n");
 
 	/* Make sure XWayland clients don't connect to the parent X server,
 	 * e.g when running in the x11 backend or the wayland backend and the
@@ -2838,6 +3541,60 @@ setup(void)
 #endif
 }
 
+void
+setupkeys(void)
+{
+	/* keybinding() runs for every keysym of every key press and repeat,
+	 * so keys[] and chords[] are compiled into a trie whose transitions
+	 * live in an open addressing table that is at most half full. The
+	 * root is node 0, every chord prefix is a node of its own */
+	const Key *k;
+	const Chord *ch;
+	const Stroke *st;
+	Binding *b;
+	size_t size = 1, n = LENGTH(keys);
+	int node, nodes = 0, last;
+	char name[64];
+
+	for (ch = chords; ch < END(chords); ch++)
+		n += CHORDLEN;
+	while (size < 2 * n)
+		size <<= 1;
+	bindings = ecalloc(size, sizeof(*bindings));
+	bindingmask = size - 1;
+
+	/* like the scan this replaces, the first binding of a combination wins */
+	for (k = keys; k < END(keys); k++) {
+		b = findbinding(0, k->mod, k->keysym);
+		if (!k->func || b->keysym != XKB_KEY_NoSymbol)
+			continue;
+		*b = (Binding){0, k->mod, k->keysym, 0, 0, k->func, &k->arg};
+	}
+
+	for (ch = chords; ch < END(chords); ch++) {
+		node = 0;
+		for (st = ch->keys; st < END(ch->keys) && st->keysym != XKB_KEY_NoSymbol; st++) {
+			b = findbinding(node, st->mod, st->keysym);
+			last = st + 1 == END(ch->keys) || st[1].keysym == XKB_KEY_NoSymbol;
+			/* a prefix is shared with every chord that starts the same */
+			if (b->keysym == XKB_KEY_NoSymbol) {
+				*b = last ? (Binding){node, st->mod, st->keysym, 0, ch->mode, ch->func, &ch->arg}
+						: (Binding){node, st->mod, st->keysym, ++nodes, 0, NULL, NULL};
+			} else if (last || !b->next) {
+				/* bound to a function, or the chord is a prefix of another */
+				xkb_keysym_get_name(st->keysym, name, sizeof(name));
+				fprintf(stderr, "dwl: chords[%d]: key %d (%s) is already bound, "
+						"ignoring the chord\n", (int)(ch - chords),
+						(int)(st - ch->keys) + 1, name);
+				break;
+			}
+			node = b->next;
+		}
+	}
+
+	chordtimer = wl_event_loop_add_timer(event_loop, chordexpire, NULL);
+}
+
 void
 spawn(const Arg *arg)
 {
@@ -2861,20 +3618,10 @@ startdrag(struct wl_listener *listener, void *data)
 	LISTEN_STATIC(&drag->icon->events.destroy, destroydragicon);
 }
 
-int
+void
 status_in(void *data)
 {
-	struct statusbar *bar = data;
-	formatstatusbar(&bar->system_info);
 	drawbars();
-
-	// reset the timer back to 45 seconds.
-	// arbitrary choice of time, I just wanted to aim to at least update it close to the minute
-	// mark just so it isn't too far off from like my phone or something
-	// yes this is hard coding it. I will spend time on this later.
-	wl_event_source_timer_update(bar->timed_event_source, 45000);
-
-	return 0;
 }
 
 void
@@ -2904,6 +3651,7 @@ tile(Monitor *m)
 	unsigned int mw, my, ty;
 	int i, n = 0;
 	Client *c;
+	PROBE_SCOPE("tile");
 
 	wl_list_for_each(c, &clients, link)
 		if (VISIBLEON(c, m) && !c->isfloating && !c->isfullscreen)
@@ -3012,6 +3760,8 @@ unmapnotify(struct wl_listener *listener, void *data)
 {
 	/* Called when the surface is unmapped, and should no longer be shown. */
 	Client *c = wl_container_of(listener, c, unmap);
+	TRACE_INSTANT("unmap", 0);
+	indexgen++;
 	if (c == grabc) {
 		cursor_mode = CurNormal;
 		grabc = NULL;
@@ -3049,6 +3799,8 @@ updatemons(struct wl_listener *listener, void *data)
 	struct wlr_output_configuration_head_v1 *config_head;
 	Monitor *m;
 
+	indexgen++;
+
 	/* First remove from the layout the disabled monitors */
 	wl_list_for_each(m, &mons, link) {
 		if (m->wlr_output->enabled || m->asleep)
@@ -3129,8 +3881,6 @@ updatemons(struct wl_listener *listener, void *data)
 		}
 	}
 
-	// TODO figure out how to make this not constantly update
-	formatstatusbar(&statusbar.system_info);
 	wl_list_for_each(m, &mons, link) {
 		updatebar(m);
 		drawbar(m);
@@ -3156,14 +3906,20 @@ updatebar(Monitor *m)
 	m->b.real_width = (int)((float)m->b.width / m->wlr_output->scale);
 
 	wlr_scene_node_set_enabled(&m->scene_buffer->node, m->wlr_output->enabled ? showbar : 0);
+	scenegen++;
 
 	if (m->b.scale == m->wlr_output->scale && m->drw)
 		return;
 
+	/* The bar is rasterized at the output's scale, so the buffer maps
+	 * onto output pixels 1:1 and the compositor never has to stretch it */
+	if (drwl_set_scale(m->drw, m->wlr_output->scale))
+		die("failed to create drwl context");
+
 	m->b.scale = m->wlr_output->scale;
 	m->lrpad = m->drw->font->height;
-	m->b.height = m->drw->font->height + 2;
-	m->b.real_height = (int)((float)m->b.height / m->wlr_output->scale);
+	m->b.height = m->drw->font->height + (int)(2 * m->b.scale + 0.5f);
+	m->b.real_height = (int)roundf((float)m->b.height / m->b.scale);
 }
 
 void
@@ -3187,7 +3943,7 @@ urgent(struct wl_listener *listener, void *data)
 	drawbars();
 
 	if (client_surface(c)->mapped)
-		client_set_border_color(c, (float[])COLOR(colors[SchemeUrg][ColBorder]));
+		client_set_border_color(c, schemes[SchemeUrg][ColBorder].rgba);
 }
 
 void
@@ -3239,15 +3995,29 @@ void
 xytonode(double x, double y, struct wlr_surface **psurface,
 		Client **pc, LayerSurface **pl, double *nx, double *ny)
 {
-	struct wlr_scene_node *node, *pnode;
+	struct wlr_scene_node *node, *pnode, *hitnode = NULL;
 	struct wlr_surface *surface = NULL;
 	struct wlr_scene_surface *scene_surface = NULL;
 	Client *c = NULL;
 	LayerSurface *l = NULL;
-	int layer;
+	double sx = 0, sy = 0;
+	int layer, hitlayer = 0;
+
+	/* Pointer motion comes at the polling rate of the mouse, mostly
+	 * without the scene changing in between, so walking it again can
+	 * usually be skipped */
+	if (hit.gen == scenegen && hit.index == indexgen
+			&& wlr_box_contains_point(&hit.box, x, y)) {
+		if (psurface) *psurface = hit.surface;
+		if (pc) *pc = hit.c;
+		if (pl) *pl = hit.l;
+		if (nx) *nx = x - hit.x;
+		if (ny) *ny = y - hit.y;
+		return;
+	}
 
 	for (layer = NUM_LAYERS - 1; !surface && layer >= 0; layer--) {
-		if (!(node = wlr_scene_node_at(&layers[layer]->node, x, y, nx, ny)))
+		if (!(node = nodeat(layer, x, y, &sx, &sy)))
 			continue;
 
 		if (node->type == WLR_SCENE_NODE_BUFFER) {
@@ -3255,6 +4025,8 @@ xytonode(double x, double y, struct wlr_surface **psurface,
 					wlr_scene_buffer_from_node(node));
 			if (!scene_surface) continue;
 			surface = scene_surface->surface;
+			hitnode = node;
+			hitlayer = layer;
 		}
 		/* Walk the tree to find a node that knows the client */
 		for (pnode = node; pnode && !c; pnode = &pnode->parent->node)
@@ -3265,6 +4037,10 @@ xytonode(double x, double y, struct wlr_surface **psurface,
 		}
 	}
 
+	if (surface)
+		cachehit(hitnode, hitlayer, x, y, sx, sy, surface, c, l);
+	if (nx) *nx = sx;
+	if (ny) *ny = sy;
 	if (psurface) *psurface = surface;
 	if (pc) *pc = c;
 	if (pl) *pl = l;
@@ -3397,7 +4173,7 @@ sethints(struct wl_listener *listener, void *data)
 	drawbars();
 
 	if (c->isurgent && surface && surface->mapped)
-		client_set_border_color(c, (float[])COLOR(colors[SchemeUrg][ColBorder]));
+		client_set_border_color(c, schemes[SchemeUrg][ColBorder].rgba);
 }
 
 void
@@ -3438,9 +4214,11 @@ main(int argc, char *argv[])
 	char *startup_cmd = NULL;
 	int c;
 
-	while ((c = getopt(argc, argv, "s:hdv")) != -1) {
+	while ((c = getopt(argc, argv, "s:xhdv")) != -1) {
 		if (c == 's')
 			startup_cmd = optarg;
+		else if (c == 'x')
+			exitwithchild = 1;
 		else if (c == 'd')
 			log_level = WLR_DEBUG;
 		else if (c == 'v')
@@ -3460,5 +4238,5 @@ main(int argc, char *argv[])
 	return EXIT_SUCCESS;
 
 usage:
-	die("Usage: %s [-v] [-d] [-s startup command]", argv[0]);
+	die("Usage: %s [-v] [-d] [-s startup command [-x]]", argv[0]);
 }
@@ -0,0 +1,259 @@
+#include "fill.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILL_X86
+#endif
+
+// larger corners are drawn with this radius
+#define FILL_RADIUS_MAX (32)
+// samples per pixel along each axis when computing corner coverage
+#define FILL_SUBSAMPLES (4)
+
+typedef void (*span_func)(uint32_t *dst, int n, uint32_t pixel);
+
+// top left corner coverage, radius * radius of each mask is used,
+// sized up front so there is nothing to allocate or free
+static uint8_t corner_masks[FILL_RADIUS_MAX + 1][FILL_RADIUS_MAX * FILL_RADIUS_MAX];
+static uint8_t corner_ready[FILL_RADIUS_MAX + 1];
+
+static void span_store_scalar(uint32_t *dst, int n, uint32_t pixel) {
+	while (n-- > 0) {
+		*dst++ = pixel;
+	}
+}
+
+#ifdef FILL_X86
+__attribute__((target("sse2")))
+static void span_store_sse2(uint32_t *dst, int n, uint32_t pixel) {
+	__m128i value = _mm_set1_epi32((int)pixel);
+
+	for (; n >= 4; n -= 4, dst += 4) {
+		_mm_storeu_si128((__m128i *)dst, value);
+	}
+
+	span_store_scalar(dst, n, pixel);
+}
+
+__attribute__((target("avx2")))
+static void span_store_avx2(uint32_t *dst, int n, uint32_t pixel) {
+	__m256i value = _mm256_set1_epi32((int)pixel);
+
+	for (; n >= 8; n -= 8, dst += 8) {
+		_mm256_storeu_si256((__m256i *)dst, value);
+	}
+
+	span_store_scalar(dst, n, pixel);
+}
+#endif
+
+// picks the widest store the cpu supports, once
+static void span_store(uint32_t *dst, int n, uint32_t pixel) {
+	static span_func store;
+
+	if (!store) {
+		store = span_store_scalar;
+#ifdef FILL_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			store = span_store_avx2;
+		} else if (__builtin_cpu_supports("sse2")) {
+			store = span_store_sse2;
+		}
+#endif
+	}
+
+	store(dst, n, pixel);
+}
+
+// src over dst for premultiplied pixels
+static uint32_t blend(uint32_t dst, uint32_t src) {
+	uint32_t inverse = 255 - (src >> 24);
+	uint32_t rb = (dst & 0x00ff00ff) * inverse + 0x00800080;
+	uint32_t ag = ((dst >> 8) & 0x00ff00ff) * inverse + 0x00800080;
+
+	// divide both channel pairs by 255 at once
+	rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+	ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+
+	return src + (rb | ag);
+}
+
+// scales every channel of a premultiplied pixel by coverage / 255
+static uint32_t scale(uint32_t pixel, uint8_t coverage) {
+	uint32_t rb = (pixel & 0x00ff00ff) * coverage + 0x00800080;
+	uint32_t ag = ((pixel >> 8) & 0x00ff00ff) * coverage + 0x00800080;
+
+	rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+	ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+
+	return rb | ag;
+}
+
+static void put_span(struct fill_target *target, int x, int y, int n, uint32_t pixel, enum fill_op op) {
+	uint32_t *dst;
+
+	if (y < target->clip.y1 || y >= target->clip.y2) {
+		return;
+	}
+
+	if (x < target->clip.x1) {
+		n -= target->clip.x1 - x;
+		x = target->clip.x1;
+	}
+	if (x + n > target->clip.x2) {
+		n = target->clip.x2 - x;
+	}
+	if (n <= 0) {
+		return;
+	}
+
+	dst = target->pixels + y * target->stride + x;
+
+	// an opaque color covers whatever was there
+	if (op == FillSource || pixel >> 24 == 0xff) {
+		span_store(dst, n, pixel);
+		return;
+	}
+
+	if (pixel >> 24 == 0) {
+		return;
+	}
+
+	while (n-- > 0) {
+		*dst = blend(*dst, pixel);
+		dst++;
+	}
+}
+
+static void put_coverage(struct fill_target *target, int x, int y, uint32_t pixel, uint8_t coverage) {
+	uint32_t *dst;
+
+	if (x < target->clip.x1 || x >= target->clip.x2 || y < target->clip.y1 || y >= target->clip.y2) {
+		return;
+	}
+
+	if (coverage == 0) {
+		return;
+	}
+
+	dst = target->pixels + y * target->stride + x;
+	*dst = blend(*dst, coverage == 0xff ? pixel : scale(pixel, coverage));
+}
+
+// Coverage of the top left quarter of a circle with the given radius,
+// the other corners are mirrored from it
+static const uint8_t *corner_mask(int radius) {
+	uint8_t *mask = corner_masks[radius];
+	double sx, sy, dx, dy;
+	int x, y, i, j, inside;
+
+	if (corner_ready[radius]) {
+		return mask;
+	}
+
+	for (y = 0; y < radius; y++) {
+		for (x = 0; x < radius; x++) {
+			inside = 0;
+			for (j = 0; j < FILL_SUBSAMPLES; j++) {
+				for (i = 0; i < FILL_SUBSAMPLES; i++) {
+					sx = x + (i + 0.5) / FILL_SUBSAMPLES;
+					sy = y + (j + 0.5) / FILL_SUBSAMPLES;
+					dx = radius - sx;
+					dy = radius - sy;
+					inside += dx * dx + dy * dy <= (double)radius * radius;
+				}
+			}
+			mask[y * radius + x] = (uint8_t)(inside * 255 / (FILL_SUBSAMPLES * FILL_SUBSAMPLES));
+		}
+	}
+
+	corner_ready[radius] = 1;
+	return mask;
+}
+
+uint32_t fill_pixel(uint32_t color) {
+	uint32_t a = color & 0xff;
+	uint32_t r = (color >> 24) & 0xff;
+	uint32_t g = (color >> 16) & 0xff;
+	uint32_t b = (color >> 8) & 0xff;
+
+	r = (r * a + 127) / 255;
+	g = (g * a + 127) / 255;
+	b = (b * a + 127) / 255;
+
+	return a << 24 | r << 16 | g << 8 | b;
+}
+
+void fill_rect(struct fill_target *target, int x, int y, int w, int h, uint32_t pixel, enum fill_op op) {
+	int row;
+
+	if (y < target->clip.y1) {
+		h -= target->clip.y1 - y;
+		y = target->clip.y1;
+	}
+	if (y + h > target->clip.y2) {
+		h = target->clip.y2 - y;
+	}
+
+	for (row = y; row < y + h; row++) {
+		put_span(target, x, row, w, pixel, op);
+	}
+}
+
+void fill_outline(struct fill_target *target, int x, int y, int w, int h, uint32_t pixel) {
+	if (w <= 0 || h <= 0) {
+		return;
+	}
+
+	put_span(target, x, y, w, pixel, FillOver);
+	if (h > 1) {
+		put_span(target, x, y + h - 1, w, pixel, FillOver);
+	}
+
+	// the sides without the corners, those belong to the rows above
+	if (h > 2) {
+		fill_rect(target, x, y + 1, 1, h - 2, pixel, FillOver);
+		if (w > 1) {
+			fill_rect(target, x + w - 1, y + 1, 1, h - 2, pixel, FillOver);
+		}
+	}
+}
+
+void fill_rounded_rect(struct fill_target *target, int x, int y, int w, int h, int radius, uint32_t pixel) {
+	const uint8_t *mask, *coverage;
+	int row, col, corner_row;
+
+	if (radius > w / 2) {
+		radius = w / 2;
+	}
+	if (radius > h / 2) {
+		radius = h / 2;
+	}
+	if (radius > FILL_RADIUS_MAX) {
+		radius = FILL_RADIUS_MAX;
+	}
+
+	if (radius <= 0) {
+		fill_rect(target, x, y, w, h, pixel, FillOver);
+		return;
+	}
+	mask = corner_mask(radius);
+
+	for (row = 0; row < h; row++) {
+		if (row >= radius && row < h - radius) {
+			put_span(target, x, y + row, w, pixel, FillOver);
+			continue;
+		}
+
+		// bottom rows are the top rows upside down
+		corner_row = row < radius ? row : h - 1 - row;
+		coverage = mask + corner_row * radius;
+
+		for (col = 0; col < radius; col++) {
+			put_coverage(target, x + col, y + row, pixel, coverage[col]);
+			put_coverage(target, x + w - 1 - col, y + row, pixel, coverage[col]);
+		}
+		put_span(target, x + radius, y + row, w - 2 * radius, pixel, FillOver);
+	}
+}
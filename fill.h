@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// Span fills for the flat parts of the bar. These write straight into
+// ARGB8888 pixels (premultiplied, like cairo's image surfaces) instead of
+// building a cairo path for every axis aligned box.
+
+enum fill_op {
+	// blend on top of what's there
+	FillOver,
+	// replace what's there
+	FillSource
+};
+
+struct fill_target {
+	uint32_t *pixels;
+	// in pixels, not bytes
+	int stride;
+	int width, height;
+
+	// nothing outside of this is touched
+	struct {
+		int x1, y1, x2, y2;
+	} clip;
+};
+
+// converts a 0xRRGGBBAA color (see config.def.h) to a premultiplied pixel
+uint32_t fill_pixel(uint32_t color);
+
+void fill_rect(struct fill_target *target, int x, int y, int w, int h, uint32_t pixel, enum fill_op op);
+
+// a 1px border along the inside of the box
+void fill_outline(struct fill_target *target, int x, int y, int w, int h, uint32_t pixel);
+
+// the corners are antialiased with coverage masks that are
+// computed once per radius
+void fill_rounded_rect(struct fill_target *target, int x, int y, int w, int h, int radius, uint32_t pixel);
@@ -0,0 +1,144 @@
+#include "frames.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// distinct clients listed for the skipped frames of a dump
+#define BLOCKERS_MAX (8)
+
+static uint64_t timespec_ns(const struct timespec *ts) {
+	return (uint64_t)ts->tv_sec * 1000000000u + ts->tv_nsec;
+}
+
+static int compare_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+// prints p50, p99 & max of the n sorted values, in microseconds
+static void print_distribution(FILE *file, const char *label, uint32_t *values, int n) {
+	if (!n) {
+		fprintf(file, "  %-8s -\n", label);
+		return;
+	}
+
+	qsort(values, n, sizeof(*values), compare_u32);
+	fprintf(file, "  %-8s p50 %.1f p99 %.1f max %.1f us over %d frames\n", label,
+			values[n / 2] / 1e3, values[(n * 99) / 100] / 1e3, values[n - 1] / 1e3, n);
+}
+
+uint64_t frame_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_ns(&ts);
+}
+
+struct frame_record *frame_begin(struct frame_stats *stats) {
+	struct frame_record *frame = &stats->ring[stats->count++ % FRAME_RING];
+
+	memset(frame, 0, sizeof(*frame));
+	frame->start = frame_now();
+
+	return frame;
+}
+
+void frame_idle(struct frame_stats *stats, struct frame_record *frame) {
+	stats->idle++;
+	frame->result = FrameIdle;
+}
+
+void frame_skipped(struct frame_stats *stats, struct frame_record *frame, const char *blocker) {
+	stats->skipped++;
+	frame->result = FrameSkipped;
+	snprintf(frame->blocker, sizeof(frame->blocker), "%s", blocker ? blocker : "?");
+}
+
+void frame_committed(struct frame_stats *stats, struct frame_record *frame,
+		uint64_t commit_start, uint32_t commit_seq, int ok) {
+	frame->commit_ns = (uint32_t)(frame_now() - commit_start);
+	frame->commit_seq = commit_seq;
+	if (ok) {
+		stats->committed++;
+		frame->result = FrameCommitted;
+	} else {
+		stats->failed++;
+		frame->result = FrameFailed;
+	}
+}
+
+void frame_presented(struct frame_stats *stats, uint32_t commit_seq, int presented,
+		const struct timespec *when) {
+	struct frame_record *frame;
+	uint64_t i, presented_at;
+
+	if (!presented) {
+		stats->discarded++;
+		return;
+	}
+	stats->presented++;
+
+	// presentation follows the commit within a frame or two
+	for (i = 0; i < stats->count && i < FRAME_RING; i++) {
+		frame = &stats->ring[(stats->count - 1 - i) % FRAME_RING];
+		if (frame->result != FrameCommitted || frame->commit_seq != commit_seq) {
+			continue;
+		}
+
+		presented_at = when ? timespec_ns(when) : frame_now();
+		if (presented_at > frame->start) {
+			frame->present_ns = (uint32_t)(presented_at - frame->start);
+		}
+		return;
+	}
+}
+
+void frame_stats_dump(FILE *file, const char *name, const struct frame_stats *stats) {
+	uint32_t commits[FRAME_RING], presents[FRAME_RING];
+	const char *blockers[BLOCKERS_MAX];
+	int blocker_counts[BLOCKERS_MAX];
+	int commit_count = 0, present_count = 0, blocker_count = 0;
+	const struct frame_record *frame;
+	uint64_t i;
+	int j;
+
+	fprintf(file, "%s: %llu committed, %llu idle, %llu skipped, %llu failed, %llu gamma fallbacks, "
+			"%llu presented, %llu discarded\n", name,
+			(unsigned long long)stats->committed, (unsigned long long)stats->idle,
+			(unsigned long long)stats->skipped,
+			(unsigned long long)stats->failed, (unsigned long long)stats->gamma_fallbacks,
+			(unsigned long long)stats->presented, (unsigned long long)stats->discarded);
+
+	for (i = 0; i < stats->count && i < FRAME_RING; i++) {
+		frame = &stats->ring[i];
+		if (frame->result == FrameCommitted) {
+			commits[commit_count++] = frame->commit_ns;
+			if (frame->present_ns) {
+				presents[present_count++] = frame->present_ns;
+			}
+		} else if (frame->result == FrameSkipped) {
+			for (j = 0; j < blocker_count; j++) {
+				if (strcmp(blockers[j], frame->blocker) == 0) {
+					break;
+				}
+			}
+			if (j == blocker_count) {
+				if (blocker_count == BLOCKERS_MAX) {
+					continue;
+				}
+				blockers[blocker_count] = frame->blocker;
+				blocker_counts[blocker_count++] = 0;
+			}
+			blocker_counts[j]++;
+		}
+	}
+
+	print_distribution(file, "commit", commits, commit_count);
+	print_distribution(file, "present", presents, present_count);
+	for (j = 0; j < blocker_count; j++) {
+		fprintf(file, "  skipped %d of the last %d frames waiting for %s\n", blocker_counts[j],
+				stats->count < FRAME_RING ? (int)stats->count : FRAME_RING, blockers[j]);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// frames remembered per monitor
+#define FRAME_RING (64)
+#define FRAME_BLOCKER_MAX (32)
+
+enum frame_result {
+	// rendermon() hasn't finished the frame yet
+	FramePending,
+	FrameCommitted,
+	// the scene had no damage, nothing was committed
+	FrameIdle,
+	// a tiled client on the monitor hadn't caught up with its resize yet
+	FrameSkipped,
+	// the backend rejected the commit
+	FrameFailed,
+};
+
+struct frame_record {
+	// CLOCK_MONOTONIC, ns, when rendermon() started
+	uint64_t start;
+	uint32_t commit_ns;
+	// from the start of the frame to its presentation, 0 until presented
+	uint32_t present_ns;
+	// wlr_output.commit_seq after a successful commit, matches the present event
+	uint32_t commit_seq;
+	enum frame_result result;
+	// app_id of the client a skipped frame waited for
+	char blocker[FRAME_BLOCKER_MAX];
+};
+
+// Frame timing of one monitor, kept by rendermon() & presentmon() in dwl.c
+// and printed by frame_stats_dump(). see stats.h
+struct frame_stats {
+	uint64_t committed;
+	uint64_t idle;
+	uint64_t skipped;
+	uint64_t failed;
+	// gamma changes the output rejected, the frame went out without them
+	uint64_t gamma_fallbacks;
+	uint64_t presented;
+	// commits the backend never showed
+	uint64_t discarded;
+
+	struct frame_record ring[FRAME_RING];
+	// total number of frames, the newest is ring[(count - 1) % FRAME_RING]
+	uint64_t count;
+};
+
+uint64_t frame_now(void);
+
+// starts the record of a new frame, overwriting the oldest one
+struct frame_record *frame_begin(struct frame_stats *stats);
+
+void frame_idle(struct frame_stats *stats, struct frame_record *frame);
+
+void frame_skipped(struct frame_stats *stats, struct frame_record *frame, const char *blocker);
+
+// ends a commit started at commit_start, ok is what the commit returned
+// and commit_seq the wlr_output.commit_seq it left behind
+void frame_committed(struct frame_stats *stats, struct frame_record *frame,
+		uint64_t commit_start, uint32_t commit_seq, int ok);
+
+void frame_presented(struct frame_stats *stats, uint32_t commit_seq, int presented,
+		const struct timespec *when);
+
+void frame_stats_dump(FILE *file, const char *name, const struct frame_stats *stats);
@@ -0,0 +1,190 @@
+#include "probes.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+struct probe_slot {
+	const char *name;
+	// NULL for scopes
+	wl_notify_func_t handler;
+	struct probe_histogram histogram;
+};
+
+static struct probe_slot slots[PROBE_SLOTS];
+static int slot_count;
+
+static void handle(int slot, struct wl_listener *listener, void *data) {
+	uint64_t start = probe_now();
+	uint64_t end;
+
+	slots[slot].handler(listener, data);
+	end = probe_now();
+	probe_record(slot, end - start);
+	trace_span(slots[slot].name, 0, start, end, 0);
+}
+
+// A listener only hands its notify function the listener itself, which
+// is embedded in objects all over dwl.c. Rather than looking the real
+// handler up by listener, every slot gets a notify function of its own
+#define TRAMPOLINE(n) \
+	static void trampoline_##n(struct wl_listener *listener, void *data) { \
+		handle(n, listener, data); \
+	}
+#define TRAMPOLINES(h) \
+	TRAMPOLINE(0x##h##0) TRAMPOLINE(0x##h##1) TRAMPOLINE(0x##h##2) TRAMPOLINE(0x##h##3) \
+	TRAMPOLINE(0x##h##4) TRAMPOLINE(0x##h##5) TRAMPOLINE(0x##h##6) TRAMPOLINE(0x##h##7) \
+	TRAMPOLINE(0x##h##8) TRAMPOLINE(0x##h##9) TRAMPOLINE(0x##h##a) TRAMPOLINE(0x##h##b) \
+	TRAMPOLINE(0x##h##c) TRAMPOLINE(0x##h##d) TRAMPOLINE(0x##h##e) TRAMPOLINE(0x##h##f)
+#define ENTRIES(h) \
+	trampoline_0x##h##0, trampoline_0x##h##1, trampoline_0x##h##2, trampoline_0x##h##3, \
+	trampoline_0x##h##4, trampoline_0x##h##5, trampoline_0x##h##6, trampoline_0x##h##7, \
+	trampoline_0x##h##8, trampoline_0x##h##9, trampoline_0x##h##a, trampoline_0x##h##b, \
+	trampoline_0x##h##c, trampoline_0x##h##d, trampoline_0x##h##e, trampoline_0x##h##f
+
+TRAMPOLINES(0) TRAMPOLINES(1) TRAMPOLINES(2) TRAMPOLINES(3)
+TRAMPOLINES(4) TRAMPOLINES(5) TRAMPOLINES(6) TRAMPOLINES(7)
+
+static const wl_notify_func_t trampolines[PROBE_SLOTS] = {
+	ENTRIES(0), ENTRIES(1), ENTRIES(2), ENTRIES(3),
+	ENTRIES(4), ENTRIES(5), ENTRIES(6), ENTRIES(7),
+};
+
+static int bucket_index(uint64_t ns) {
+	int shift = 0;
+	int index;
+
+	if (ns >= 1u << PROBE_SUB_BITS) {
+		shift = 63 - __builtin_clzll(ns) - PROBE_SUB_BITS;
+	}
+
+	index = (shift << PROBE_SUB_BITS) + (int)(ns >> shift);
+	return index < PROBE_BUCKETS ? index : PROBE_BUCKETS - 1;
+}
+
+// smallest value that lands in a bucket
+static uint64_t bucket_value(int index) {
+	int shift = (index >> PROBE_SUB_BITS) - 1;
+
+	if (shift <= 0) {
+		return index;
+	}
+
+	return (uint64_t)(index - (shift << PROBE_SUB_BITS)) << shift;
+}
+
+uint64_t probe_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int probe_register(const char *name) {
+	if (slot_count == PROBE_SLOTS) {
+		return -1;
+	}
+
+	slots[slot_count].name = name;
+	return slot_count++;
+}
+
+wl_notify_func_t probe_handler(wl_notify_func_t handler, const char *name) {
+	int i;
+
+	// every client adds the same few handlers again
+	for (i = 0; i < slot_count; i++) {
+		if (slots[i].handler == handler) {
+			return trampolines[i];
+		}
+	}
+
+	if ((i = probe_register(name)) < 0) {
+		return handler;
+	}
+	slots[i].handler = handler;
+
+	return trampolines[i];
+}
+
+void probe_record(int slot, uint64_t ns) {
+	struct probe_histogram *histogram;
+
+	if (slot < 0) {
+		return;
+	}
+
+	histogram = &slots[slot].histogram;
+	if (!histogram->count || ns < histogram->min) {
+		histogram->min = ns;
+	}
+	if (ns > histogram->max) {
+		histogram->max = ns;
+	}
+	histogram->count++;
+	histogram->sum += ns;
+	histogram->buckets[bucket_index(ns)]++;
+}
+
+void probe_leave(struct probe_scope *scope) {
+	uint64_t end = probe_now();
+
+	probe_record(scope->slot, end - scope->start);
+	if (scope->slot >= 0) {
+		trace_span(slots[scope->slot].name, 0, scope->start, end, 0);
+	}
+}
+
+uint64_t probe_percentile(const struct probe_histogram *histogram, double fraction) {
+	uint64_t rank = (uint64_t)(fraction * (double)histogram->count);
+	uint64_t seen = 0;
+	int i;
+
+	for (i = 0; i < PROBE_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen > rank) {
+			// the bucket's upper end, never beyond what was recorded
+			uint64_t value = bucket_value(i + 1) - 1;
+			return value < histogram->max ? value : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+static int compare_total(const void *a, const void *b) {
+	uint64_t x = slots[*(const int *)a].histogram.sum;
+	uint64_t y = slots[*(const int *)b].histogram.sum;
+
+	return (x < y) - (x > y);
+}
+
+void probe_dump(FILE *file) {
+	const struct probe_histogram *histogram;
+	int order[PROBE_SLOTS];
+	int i;
+
+	for (i = 0; i < slot_count; i++) {
+		order[i] = i;
+	}
+	qsort(order, slot_count, sizeof(*order), compare_total);
+
+	fprintf(file, "%-24s %8s %10s %10s %10s %10s %10s %10s %12s\n", "probe", "count",
+			"min", "mean", "p50", "p90", "p99", "max", "total");
+	for (i = 0; i < slot_count; i++) {
+		histogram = &slots[order[i]].histogram;
+		if (!histogram->count) {
+			continue;
+		}
+
+		// microseconds
+		fprintf(file, "%-24s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %12.1f\n",
+				slots[order[i]].name, (unsigned long long)histogram->count,
+				histogram->min / 1e3, (double)histogram->sum / histogram->count / 1e3,
+				probe_percentile(histogram, 0.5) / 1e3,
+				probe_percentile(histogram, 0.9) / 1e3,
+				probe_percentile(histogram, 0.99) / 1e3,
+				histogram->max / 1e3, histogram->sum / 1e3);
+	}
+	fflush(file);
+}
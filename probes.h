@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <wayland-server-core.h>
+
+// Latency probes, compiled in with -DPROBES only. Every handler added with
+// LISTEN() or LISTEN_STATIC() in dwl.c is timed, as is every function with
+// a PROBE_SCOPE(). The histograms are a section of the stats dump (stats.h)
+// and are printed to stdout when dwl exits. Every call is also a span of
+// the trace, if one is recorded (trace.h).
+//
+// Everything is recorded and printed from the event loop thread, so the
+// histograms need neither locks nor atomics.
+
+// handlers and scopes that can be told apart
+#define PROBE_SLOTS (128)
+
+// log-linear histogram: below 2^PROBE_SUB_BITS ns every value has its own
+// bucket, above that each power of two is split into 2^PROBE_SUB_BITS
+// buckets, so every bucket is within 1/16 of the values it holds.
+// the last bucket holds everything above ~2^51 ns
+#define PROBE_SUB_BITS (4)
+#define PROBE_BUCKETS (48 << PROBE_SUB_BITS)
+
+struct probe_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min, max;
+	uint32_t buckets[PROBE_BUCKETS];
+};
+
+// times a function from its declaration to whichever return it leaves by
+struct probe_scope {
+	int slot;
+	uint64_t start;
+};
+
+#ifdef PROBES
+// the last declaration of the function being timed
+#define PROBE_SCOPE(name) \
+	static int probe_slot_ = -1; \
+	struct probe_scope probe_scope_ __attribute__((cleanup(probe_leave))) = { \
+		probe_slot_ < 0 ? (probe_slot_ = probe_register(name)) : probe_slot_, probe_now() }
+#else
+#define PROBE_SCOPE(name)
+#endif
+
+uint64_t probe_now(void);
+
+// a slot for name, -1 once every slot is taken
+int probe_register(const char *name);
+
+// a notify function that times handler, handler itself once every slot is taken
+wl_notify_func_t probe_handler(wl_notify_func_t handler, const char *name);
+
+void probe_record(int slot, uint64_t ns);
+
+void probe_leave(struct probe_scope *scope);
+
+// value below which the given fraction of the samples lie, in ns
+uint64_t probe_percentile(const struct probe_histogram *histogram, double fraction);
+
+// one line per slot that recorded anything, most total time first
+void probe_dump(FILE *file);
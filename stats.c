@@ -0,0 +1,111 @@
+#include "stats.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static stats_dump_func sections[STATS_SECTIONS];
+static int section_count;
+
+static struct wl_event_source *signal_source;
+static struct wl_event_source *socket_source;
+static int socket_fd = -1;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static int signal_in(int signal_number, void *data) {
+	stats_dump(stderr);
+	return 0;
+}
+
+// Every connection gets one dump and is closed again. The dump is far
+// smaller than a socket buffer, so writing it doesn't block
+static int socket_in(int fd, uint32_t mask, void *data) {
+	FILE *file;
+	int client;
+
+	client = accept(fd, NULL, NULL);
+	if (client < 0) {
+		return 0;
+	}
+
+	file = fdopen(client, "w");
+	if (!file) {
+		close(client);
+		return 0;
+	}
+	stats_dump(file);
+	fclose(file);
+
+	return 0;
+}
+
+void stats_add(stats_dump_func dump) {
+	if (section_count < STATS_SECTIONS) {
+		sections[section_count++] = dump;
+	}
+}
+
+void stats_dump(FILE *file) {
+	int i;
+
+	for (i = 0; i < section_count; i++) {
+		sections[i](file);
+	}
+	fflush(file);
+}
+
+int stats_start(struct wl_event_loop *loop, const char *socket_name) {
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+	int length;
+
+	signal_source = wl_event_loop_add_signal(loop, SIGUSR1, signal_in, NULL);
+
+	if (!runtime_dir) {
+		return 1;
+	}
+	length = snprintf(socket_path, sizeof(socket_path), "%s/%s.stats", runtime_dir, socket_name);
+	if (length < 0 || (size_t)length >= sizeof(socket_path)) {
+		socket_path[0] = '\0';
+		return 1;
+	}
+	strcpy(address.sun_path, socket_path);
+
+	socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (socket_fd < 0) {
+		perror("stats: socket");
+		return 1;
+	}
+	// left behind by a dwl that didn't exit cleanly, wayland
+	// socket names are locked so no running dwl can own it
+	unlink(socket_path);
+	if (bind(socket_fd, (struct sockaddr *)&address, sizeof(address)) < 0
+			|| listen(socket_fd, 4) < 0) {
+		perror("stats: bind");
+		close(socket_fd);
+		socket_fd = -1;
+		return 1;
+	}
+
+	socket_source = wl_event_loop_add_fd(loop, socket_fd, WL_EVENT_READABLE, socket_in, NULL);
+	return 0;
+}
+
+void stats_stop(void) {
+	if (signal_source) {
+		wl_event_source_remove(signal_source);
+		signal_source = NULL;
+	}
+	if (socket_source) {
+		wl_event_source_remove(socket_source);
+		socket_source = NULL;
+	}
+	if (socket_fd >= 0) {
+		close(socket_fd);
+		unlink(socket_path);
+		socket_fd = -1;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdio.h>
+#include <wayland-server-core.h>
+
+// sections of the dump, see stats_add()
+#define STATS_SECTIONS (4)
+
+// Runtime statistics of dwl. Every section added with stats_add() is
+// printed to stderr on SIGUSR1, and to anyone who connects to
+// $XDG_RUNTIME_DIR/$WAYLAND_DISPLAY.stats, e.g.
+//   socat - UNIX-CONNECT:$XDG_RUNTIME_DIR/$WAYLAND_DISPLAY.stats
+// Sections are only ever printed from the event loop.
+typedef void (*stats_dump_func)(FILE *file);
+
+void stats_add(stats_dump_func dump);
+
+void stats_dump(FILE *file);
+
+// returns 0 on success, SIGUSR1 works even if the socket failed
+int stats_start(struct wl_event_loop *loop, const char *socket_name);
+
+void stats_stop(void);
@@ -1,294 +1,49 @@
 #include "stext.h"
 
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
-#include <time.h>
-#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <ifaddrs.h>
-#include <linux/wireless.h>
-#include <sys/ioctl.h>
-
-#define AC "/sys/class/power_supply/AC/"
-#define BAT0 "/sys/class/power_supply/BAT0/"
-
-#define SYSBUFSIZ (4096)
 
 #define ADWAITA_THEME_DIR "/usr/share/icons/Adwaita/symbolic"
-#define SVG_SURFACE_WIDTH (64)
-#define SVG_SURFACE_HEIGHT (64)
-
-#define DEG_TO_RAD(x) ((x) * (G_PI / 180.0))
+// icons are packed into rows of this width, in logical pixels
+#define ATLAS_WIDTH (256)
+// used when an svg doesn't report its own size
+#define ICON_FALLBACK_SIZE (16)
 
+// in logical pixels, see SCALE()
 #define PANEL_PADDING (4)
 #define PANEL_SPACE (8)
 #define PANEL_ROUNDNESS (4)
 
-static void formatdate(struct time_info *date) {
-	time_t now = time(NULL);
-	struct tm *tm = localtime(&now);
-	if (tm == NULL) return;
-
-	// ISO Date format, 12 hours
-	// YYYY-MM-DD HH:MM AM/PM
-	strftime(date->date, DATE_STR_MAX, "%F %I:%M %p", tm);
-}
-
-static int sysread(char *_buffer, const char *_file) {
-	int fd = open(_file, O_RDONLY);
-	struct stat stat;
-	if (fd == -1) {
-		return 1;
-	}
-
-	if (fstat(fd, &stat) == -1) {
-		goto error;
-	}
-
-	if (stat.st_size != SYSBUFSIZ) {
-		goto error;
-	}
-	
-	if (read(fd, _buffer, stat.st_size) == 0) {
-		goto error;
-	}
-
-	close(fd);
-	return 0;
-
-error:
-	close(fd);
-	return 1;
-}
-
-static void formatbat(struct battery_info *info) {
-	char buffer[SYSBUFSIZ];
-	int capacity;
-	int plugged_in;
-	char status[4] = "UNK";
-
-	if (sysread(buffer, AC "online")) {
-		return;
-	}
-	plugged_in = (int)strtol(buffer, NULL, 0);
-	info->plugged_in = plugged_in;
-
-	if (sysread(buffer, BAT0 "capacity")) {
-		return;
-	}
-	capacity = (int)strtol(buffer, NULL, 0);
-	info->capacity = capacity;
-	
-	if (sysread(buffer, BAT0 "status")) {
-		return;
-	}
-
-	// Assuming implementation of /sys/class/power_supply/BAT0/status
-	// prints shorthand of "Discharging", "Charging", "Full", and "Not charging" (Inhibited)
-	switch (buffer[0]) {
-	case 'D':
-		snprintf(status, 4, "DIS");
-		info->status = Discharging;
-		break;
-	case 'C':
-		snprintf(status, 4, "CHR");
-		info->status = Charging;
-		break;
-	case 'F':
-		snprintf(status, 4, "FUL");
-		info->status = Full;
-		break;
-	case 'N':
-		snprintf(status, 4, "INH");
-		info->status = Inhibited;
-		break;
-	}
-}
-
-static void formattemp(struct temp_info *temp) {
-	char buffer[SYSBUFSIZ];
-	int celsius;
-	
-	if (sysread(buffer, "/sys/class/thermal/thermal_zone0/temp")) {
-		return;
-	}
-
-	celsius = (int)(strtod(buffer, NULL) / 1000.0);
-
-	snprintf(temp->celsius, TEMP_STR_MAX, "%d\U000000B0C", celsius);
-}
-
-static int cmp(const char *_haystack, const char *_needle) {
-	return (strncmp(_haystack, _needle, strlen(_needle)) == 0);
-}
-
-static void formatram(struct memory_info *info) {
-	long double memtotal = 0;
-	long double memfree = 0;
-	long double buffers = 0;
-	long double cached = 0;
-	FILE *fp;
-	char line[128];
-	long double gb = 1 << 20; // I hope your system is little endian
-	long double memused; 
-
-	if (!(fp = fopen("/proc/meminfo", "rb"))) return;
+// 1 to draw icons in the color of the panel's text instead of their own
+#define TINT_ICONS (0)
 
-	while (fgets(line, 128, fp)) {
-		if (cmp(line, "MemTotal:")) {
-			memtotal = strtold(line + strlen("MemTotal:"), NULL);
-		} else if (cmp(line, "MemFree:")) {
-			memfree = strtold(line + strlen("MemFree:"), NULL);
-		} else if (cmp(line, "Buffers:")) {
-			buffers = strtold(line + strlen("Buffers:"), NULL);
-		} else if (cmp(line, "Cached:")) {
-			cached = strtold(line + strlen("Cached:"), NULL);
-		}
-
-		// early exit
-		if (!memtotal && !memfree && !buffers && !cached) break;
-	}
-
-	fclose(fp);
-
-	memused = (memtotal - memfree - buffers - cached) / gb;
-
-	snprintf(info->usage_ratio, MEMORY_STR_MAX, "%.1LfGb/%.1LfGb", memused, memtotal / gb);
-}
-
-static int resolve_ifname(struct iwreq *_rq) {
-	struct ifaddrs *head;
-	struct ifaddrs *list;
-	if (getifaddrs(&head)) {
-		return 1;
-	}
-
-	list = head;
-	
-	for (; list != NULL; list = list->ifa_next) {
-		// skip loopback device
-		if (strcmp(list->ifa_name, "lo") == 0) {
-			continue;
-		}
-		
-		// TODO add this to the wifi widget
-		// skip wireguard device
-		if (strncmp(list->ifa_name, "wg0", 2) == 0) {
-			continue;
-		}
+// logical pixels to pixels at the scale the font is rasterized at
+#define SCALE(font, px) ((int)((px) * (font)->scale + 0.5))
 
-		// skip any empty device names
-		if (!strlen(list->ifa_name)) {
-			continue;
-		}
+void color_init(struct color *color, uint32_t hex) {
+	int i;
 
-		// skip any non IPv4 devices
-		if (list->ifa_addr->sa_family != AF_INET) {
-			continue;
-		}
-
-		strncpy(_rq->ifr_name, list->ifa_name, IFNAMSIZ);
-		_rq->u.addr.sa_family = AF_INET;
-		break;
+	color->hex = hex;
+	color->pixel = fill_pixel(hex);
+	for (i = 0; i < 4; i++) {
+		color->rgba[i] = ((hex >> (24 - i * 8)) & 0xFF) / 255.0f;
 	}
-
-	freeifaddrs(head);
-	
-	return 0;
+	color->pattern = cairo_pattern_create_rgba(color->rgba[0], color->rgba[1],
+			color->rgba[2], color->rgba[3]);
 }
 
-static void formatnetwork(struct network_info *info) {
-	struct iwreq rq;
-	int fd;
-	struct sockaddr_in *in;
-	char addr[INET_ADDRSTRLEN];
-	char essid[48] = { 0 }; // null terminated aligned buffer
-	struct iw_statistics stats;
-	struct iw_range range;
-	int quality = 0;
-	
-	// default to disconnected just in case network is off
-	info->type = Disconnected;
-
-	if (resolve_ifname(&rq)) {
-		return;
-	}
-	
-	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
-	if (fd == -1) {
-		return;
-	}
-
-	// Converts numerical ip address to string address
-	if (ioctl(fd, SIOCGIFADDR, &rq) < 0) {
-		close(fd);
-		return;
-	}
-	in = (struct sockaddr_in *)&rq.u.ap_addr;
-	inet_ntop(AF_INET, &in->sin_addr, addr, INET_ADDRSTRLEN);
-
-	// Get network essid
-	rq.u.essid.pointer = essid;
-	rq.u.essid.length = IW_ESSID_MAX_SIZE;
-	rq.u.essid.flags = 0;
-	if (ioctl(fd, SIOCGIWESSID, &rq) < 0) {
-		close(fd);
-		return;
-	}
-
-	// Get network statistics
-	rq.u.data.pointer = &stats;
-	rq.u.data.length = sizeof(struct iw_statistics);
-	rq.u.data.flags = 0;
-	if (ioctl(fd, SIOCGIWSTATS, &rq) < 0) {
-		close(fd);
-		return;
-	}
-
-	// Get network range
-	rq.u.data.pointer = &range;
-	rq.u.data.length = sizeof(struct iw_range);
-	rq.u.data.flags = 0;
-	if (ioctl(fd, SIOCGIWRANGE, &rq) < 0) {
-		close(fd);
-		return;
+void color_finish(struct color *color) {
+	if (color->pattern) {
+		cairo_pattern_destroy(color->pattern);
 	}
-
-	close(fd);
-
-	if (stats.qual.qual != 0) {
-		quality = (stats.qual.qual * 100) / range.max_qual.qual;
-	}
-
-	// lets just default to wireless for now (this is bad lol)
-	info->type = Wireless;
-
-	memcpy(info->name, essid, strlen(essid));
-	info->quality = quality;
-}
-
-void formatstatusbar(struct system_info *info) {
-	formatnetwork(&info->network);
-
-	formatram(&info->memory);
-
-	formattemp(&info->temp);
-
-	formatbat(&info->charge);
-
-	formatdate(&info->date);
+	color->pattern = NULL;
 }
 
-void set_color(cairo_t *cr, uint32_t hex) {
-	double r = ((hex >> 24) & 0xFF) / 255.0;
-	double g = ((hex >> 16) & 0xFF) / 255.0;
-	double b = ((hex >> 8) & 0xFF) / 255.0;
-	double a = (hex & 0xFF) / 255.0;
-
-	cairo_set_source_rgba(cr, r, g, b, a);
+void set_color(cairo_t *cr, const struct color *color) {
+	cairo_set_source(cr, color->pattern);
 }
 
 static struct icon *get_wireless_icon(struct wireless_icons *wireless, struct network_info *info) {
@@ -306,6 +61,17 @@ static struct icon *get_wireless_icon(struct wireless_icons *wireless, struct ne
 	return icon;
 }
 
+static struct icon *get_network_icon(struct drwl_resources *resources, struct network_info *info) {
+	switch (info->type) {
+	case Wired:
+		return &resources->wired;
+	case Wireless:
+		return get_wireless_icon(&resources->wireless, info);
+	default:
+		return &resources->wireless.disconnected;
+	}
+}
+
 static struct icon *get_discharging_icon(struct discharging_icons *icons, struct battery_info *info) {
 	struct icon *icon = NULL;
 	if (info->capacity < 5) {
@@ -384,113 +150,487 @@ static struct icon *get_battery_icon(struct battery_icons *icons, struct battery
 
 static int panel_icon_width(struct font_conf *font, struct icon *icon, const char *text) {
 	if (text) {
-		return text_width(font, text) + (int)icon->viewport.width + PANEL_PADDING * 2;
+		return text_width(font, text) + icon->width + SCALE(font, PANEL_PADDING) * 2;
 	}
 
-	return (int)icon->viewport.width + PANEL_PADDING * 2;
+	return icon->width + SCALE(font, PANEL_PADDING) * 2;
 }
 
 static int panel_text_width(struct font_conf *font, const char *text) {
-	return text_width(font, text) + PANEL_PADDING;
+	return text_width(font, text) + SCALE(font, PANEL_PADDING);
 }
 
-static int draw_panel_icon(cairo_t *cr, uint32_t *scheme, struct font_conf *font, struct icon *icon, const char *text, int x, int y) {
-	int rect_width;
-	int rect_x;
-	int text_x;
-	int icon_x;
-
-	if (icon == NULL) {
-		return x;
-	}
-
-	rect_width = panel_icon_width(font, icon, text);
-	rect_x = x - rect_width;
-	text_x = rect_x + PANEL_PADDING / 2;
-	icon_x = x - ((int)icon->viewport.width + PANEL_PADDING);
+// what a single status panel displays
+struct panel {
+	const char *text;
+	struct icon *icon;
+};
 
-	set_color(cr, scheme[ColFg]);
-	filled_rounded_rect(cr, rect_x, y, rect_width, font->height, PANEL_ROUNDNESS);
+static struct panel describe_panel(struct Drwl *drwl, struct system_info *info, enum bar_segment seg) {
+	struct panel panel = { NULL, NULL };
 
-	set_color(cr, scheme[ColBg]);
-	if (text) {
-		render_text(cr, font, text_x, y, text);
+	switch (seg) {
+	case SegDate:
+		panel.text = info->date.date;
+		break;
+	case SegBattery:
+		panel.icon = get_battery_icon(&drwl->resources->battery, &info->charge);
+		break;
+	case SegTemp:
+		panel.text = info->temp.celsius;
+		break;
+	case SegMemory:
+		panel.text = info->memory.usage_ratio;
+		break;
+	case SegNetwork:
+		panel.icon = get_network_icon(drwl->resources, &info->network);
+		panel.text = info->network.name;
+		break;
+	default:
+		break;
 	}
-	render_icon(cr, icon, icon_x, y);
 
-	return rect_x - PANEL_SPACE;
+	return panel;
 }
 
-static int draw_panel_text(cairo_t *cr, uint32_t *scheme, struct font_conf *font, char *text, int x, int y) {
-	int rect_width = panel_text_width(font, text);
-	// rectangle origin is the top left. Therefore
-	// you must move it to the left of the width of the rectangle
-	// to not have it render off the side of the screen
-	int rect_x = x - rect_width;
+static void draw_panel(struct Drwl *drwl, struct panel *panel, struct segment *segment, int y) {
+	cairo_t *cr = drwl->context;
 	// inch forward by half the padding (to center it)
-	int text_x = rect_x + PANEL_PADDING / 2;
+	int text_x = segment->x + SCALE(drwl->font, PANEL_PADDING) / 2;
+	int icon_x;
 
-	set_color(cr, scheme[ColFg]);
 	// add padding to take into account the offset text (which is half of padding)
-	filled_rounded_rect(cr, rect_x, y, rect_width, font->height, PANEL_ROUNDNESS);
+	filled_rounded_rect(drwl, segment->x, y, segment->width, drwl->font->height,
+			SCALE(drwl->font, PANEL_ROUNDNESS), &drwl->scheme[ColFg]);
 
 	// don't draw text background, thus don't provide width & height
 	// this is leftover logic from sewn's drwl statusbar
-	set_color(cr, scheme[ColBg]);
-	render_text(cr, font, text_x, y, text);
+	set_color(cr, &drwl->scheme[ColBg]);
+	if (panel->text) {
+		render_text(cr, drwl->font, text_x, y, panel->text);
+	}
 
-	// move left to next panel x position
-	return rect_x - PANEL_SPACE;
+	if (panel->icon) {
+		icon_x = segment->x + segment->width - (panel->icon->width + SCALE(drwl->font, PANEL_PADDING));
+		render_icon(cr, drwl->resources->atlas, panel->icon, icon_x, y, TINT_ICONS);
+	}
 }
 
-int draw_system_info(struct Drwl *drwl, struct system_info *info, int x, int y) {
+// Positions every status panel and marks the ones that changed.
+// Returns the left most x position of the panels.
+int layout_system_info(struct Drwl *drwl, struct system_info *info, int x, int visible) {
 	int panel_x = x;
-	struct icon *icon;
+	int width;
+	int seg;
+	uint32_t hash;
+	struct panel panel;
+
+	// starts from right to left
+	for (seg = SegDate; seg < SegLast; seg++) {
+		panel = describe_panel(drwl, info, seg);
+
+		// hidden panels still have to clear where they used to be
+		if (!visible || (!panel.text && !panel.icon)) {
+			drwl_segment_set(drwl, seg, panel_x, 0, 0);
+			continue;
+		}
 
-	// starts from left to right
-	panel_x = draw_panel_text(drwl->context, drwl->scheme, drwl->font, info->date.date, panel_x, y);
+		if (panel.icon) {
+			width = panel_icon_width(drwl->font, panel.icon, panel.text);
+		} else {
+			width = panel_text_width(drwl->font, panel.text);
+		}
 
-	icon = get_battery_icon(&drwl->battery, &info->charge);
-	panel_x = draw_panel_icon(drwl->context, drwl->scheme, drwl->font, icon, NULL, panel_x, y);
+		// rectangle origin is the top left. Therefore
+		// you must move it to the left of the width of the rectangle
+		// to not have it render off the side of the screen
+		panel_x -= width;
 
-	panel_x = draw_panel_text(drwl->context, drwl->scheme, drwl->font, info->temp.celsius, panel_x, y);
+		hash = drwl_hash_scheme(DRWL_HASH_INIT, drwl->scheme);
+		hash = drwl_hash(hash, &panel.icon, sizeof(panel.icon));
+		if (panel.text) {
+			hash = drwl_hash(hash, panel.text, strlen(panel.text));
+		}
 
-	panel_x = draw_panel_text(drwl->context, drwl->scheme, drwl->font, info->memory.usage_ratio, panel_x, y);
+		drwl_segment_set(drwl, seg, panel_x, width, hash);
 
-	// this is incorrect. it should be get_network_icon
-	// and inside get_network_icon there should be a check if
-	// it's a wireless or wired connection
-	icon = get_wireless_icon(&drwl->wireless, &info->network);
-	panel_x = draw_panel_icon(drwl->context, drwl->scheme, drwl->font, icon, info->network.name, panel_x, y);
+		// move left to next panel x position
+		panel_x -= SCALE(drwl->font, PANEL_SPACE);
+	}
+
+	if (panel_x == x) {
+		return x;
+	}
 
 	// undo the last panel's spacing
-	return panel_x + PANEL_SPACE;
+	return panel_x + SCALE(drwl->font, PANEL_SPACE);
+}
+
+// Paints the status panels positioned by layout_system_info()
+void draw_system_info(struct Drwl *drwl, struct system_info *info, int y) {
+	struct panel panel;
+	int seg;
+
+	for (seg = SegDate; seg < SegLast; seg++) {
+		if (!drwl_segment_begin(drwl, seg)) {
+			continue;
+		}
+
+		panel = describe_panel(drwl, info, seg);
+		draw_panel(drwl, &panel, &drwl->segments[seg], y);
+
+		drwl_segment_end(drwl);
+	}
+}
+
+// Lays out and paints the whole bar into drwl->surface. Only segments whose
+// contents changed are cleared and painted again, see drwl->damage
+void drwl_draw_bar(struct Drwl *drwl, struct system_info *info, const struct bar_state *bar, int width, int height) {
+	const struct color *scheme = bar->selected ? bar->sel : bar->norm;
+	const struct color *color = bar->norm;
+	int boxs = drwl->font->height / 9;
+	int boxw = drwl->font->height / 6 + 2;
+	int x, w, tw, i, urgent;
+	uint32_t hash;
+
+	// the bar only has a background while a client is focused
+	drwl->scheme = scheme;
+	drwl_prepare_drawing(drwl, width, height, bar->title ? scheme[ColBg].pixel : 0);
+
+	// Lay out every segment before painting any of them, so that
+	// clearing a moved segment can't erase freshly painted pixels.
+	// status is only drawn on the selected monitor
+	tw = width - layout_system_info(drwl, info, width, bar->selected);
+
+	x = 0;
+	for (i = 0; i < bar->tag_count; i++) {
+		x += text_width(drwl->font, bar->tags[i]) + bar->lrpad;
+	}
+	hash = drwl_hash(DRWL_HASH_INIT, &bar->tagset, sizeof(bar->tagset));
+	hash = drwl_hash(hash, &bar->occupied, sizeof(bar->occupied));
+	hash = drwl_hash(hash, &bar->urgent, sizeof(bar->urgent));
+	hash = drwl_hash(hash, &bar->focused, sizeof(bar->focused));
+	hash = drwl_hash_scheme(hash, bar->norm);
+	hash = drwl_hash_scheme(hash, bar->sel);
+	drwl_segment_set(drwl, SegTags, 0, x, hash);
+
+	w = width - tw - x;
+	hash = DRWL_HASH_INIT;
+	if (w > height) {
+		if (bar->title) {
+			color = scheme;
+			hash = drwl_hash(hash, bar->title, strlen(bar->title));
+		}
+		hash = drwl_hash(hash, &bar->client, sizeof(bar->client));
+		hash = drwl_hash_scheme(hash, color);
+	} else {
+		w = 0;
+	}
+	drwl_segment_set(drwl, SegTitle, x, w, hash);
+
+	draw_system_info(drwl, info, 0);
+
+	if (drwl_segment_begin(drwl, SegTags)) {
+		x = 0;
+		for (i = 0; i < bar->tag_count; i++) {
+			w = text_width(drwl->font, bar->tags[i]) + bar->lrpad;
+			drwl->scheme = bar->tagset & 1u << i ? bar->sel : bar->norm;
+			urgent = bar->urgent & 1u << i ? 1 : 0;
+			filled_rect(drwl, x, 0, w, height, &drwl->scheme[urgent ? ColFg : ColBg]);
+			set_color(drwl->context, &drwl->scheme[urgent ? ColBg : ColFg]);
+			render_text(drwl->context, drwl->font, x + bar->lrpad / 2, 0, bar->tags[i]);
+
+			if (bar->occupied & 1u << i) {
+				if (bar->focused & 1u << i) {
+					filled_rect(drwl, x + boxs, boxs, boxw, boxw, &drwl->scheme[urgent ? ColBg : ColFg]);
+				} else {
+					delineate_rect(drwl, x + boxs, boxs, boxw, boxw, &drwl->scheme[urgent ? ColBg : ColFg]);
+				}
+			}
+			x += w;
+		}
+		drwl_segment_end(drwl);
+	}
+
+	if (drwl_segment_begin(drwl, SegTitle)) {
+		x = drwl->segments[SegTitle].x;
+		w = drwl->segments[SegTitle].width;
+		drwl->scheme = color;
+		if (bar->title) {
+			set_color(drwl->context, &color[ColFg]);
+			render_text(drwl->context, drwl->font, x + bar->lrpad / 2, 0, bar->title);
+		} else {
+			delineate_rect(drwl, x, 0, w, height, &color[ColBg]);
+		}
+		drwl_segment_end(drwl);
+	}
+
+	drwl_finish_drawing(drwl);
 }
 
-static void load_icon(const char *file, struct icon *icon) {	
+// every icon the statusbar can draw, and where it lives inside struct drwl_resources
+static const struct {
+	const char *file;
+	size_t offset;
+} icon_files[] = {
+	// wired networks
+	{ ADWAITA_THEME_DIR "/status/network-wired-symbolic.svg", offsetof(struct drwl_resources, wired) },
+
+	// wireless networks
+	{ ADWAITA_THEME_DIR "/status/network-wireless-disabled-symbolic.svg", offsetof(struct drwl_resources, wireless.disconnected) },
+	{ ADWAITA_THEME_DIR "/status/network-wireless-signal-good-symbolic.svg", offsetof(struct drwl_resources, wireless.good) },
+	{ ADWAITA_THEME_DIR "/status/network-wireless-signal-ok-symbolic.svg", offsetof(struct drwl_resources, wireless.okay) },
+	{ ADWAITA_THEME_DIR "/status/network-wireless-signal-weak-symbolic.svg", offsetof(struct drwl_resources, wireless.weak) },
+	{ ADWAITA_THEME_DIR "/status/network-wireless-signal-none-symbolic.svg", offsetof(struct drwl_resources, wireless.none) },
+
+	// battery while charging
+	{ ADWAITA_THEME_DIR "/status/battery-level-10-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._10) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-20-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._20) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-30-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._30) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-40-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._40) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-50-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._50) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-60-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._60) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-70-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._70) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-80-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._80) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-90-charging-symbolic.svg", offsetof(struct drwl_resources, battery.charging._90) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-100-charged-symbolic.svg", offsetof(struct drwl_resources, battery.charging._100) },
+
+	// battery while discharging
+	{ ADWAITA_THEME_DIR "/status/battery-level-0-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._0) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-10-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._10) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-20-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._20) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-30-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._30) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-40-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._40) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-50-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._50) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-60-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._60) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-70-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._70) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-80-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._80) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-90-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._90) },
+	{ ADWAITA_THEME_DIR "/status/battery-level-100-symbolic.svg", offsetof(struct drwl_resources, battery.discharging._100) },
+};
+
+#define ICON_COUNT (sizeof(icon_files) / sizeof(icon_files[0]))
+
+// Rasterizes every svg exactly once, at the scale of the font, into one
+// atlas surface. Icons are placed left to right into rows (shelves).
+// The svg handles are only needed while rasterizing, afterwards
+// drawing an icon is nothing but a blit out of the atlas.
+static cairo_surface_t *create_icon_atlas(struct drwl_resources *resources) {
+	RsvgHandle *handles[ICON_COUNT] = { 0 };
+	RsvgRectangle viewport;
 	GError *error = NULL;
+	cairo_surface_t *atlas;
+	cairo_t *cr;
+	struct icon *icon;
 	double svg_width;
 	double svg_height;
+	int shelf_x = 0;
+	int shelf_y = 0;
+	int shelf_height = 0;
+	int atlas_width = (int)ceil(ATLAS_WIDTH * resources->font.scale);
+	size_t i;
+
+	// first pass: figure out where every icon goes
+	for (i = 0; i < ICON_COUNT; i++) {
+		icon = (struct icon *)((char *)resources + icon_files[i].offset);
+
+		handles[i] = rsvg_handle_new_from_file(icon_files[i].file, &error);
+		if (error) {
+			fprintf(stderr, "Error loading icon: %s\n", error->message);
+			g_error_free(error);
+			error = NULL;
+			handles[i] = NULL;
+			continue;
+		}
 
-	icon->handle = rsvg_handle_new_from_file(file, &error);
-	if (error) {
-		fprintf(stderr, "Error loading icon: %s\n", error->message);
-		return;
+		if (!rsvg_handle_get_intrinsic_size_in_pixels(handles[i], &svg_width, &svg_height)) {
+			svg_width = ICON_FALLBACK_SIZE;
+			svg_height = ICON_FALLBACK_SIZE;
+		}
+
+		icon->width = (int)ceil(svg_width * resources->font.scale);
+		icon->height = (int)ceil(svg_height * resources->font.scale);
+		if (icon->width > atlas_width) {
+			icon->width = atlas_width;
+		}
+
+		// start a new shelf when this row is full
+		if (shelf_x + icon->width > atlas_width) {
+			shelf_x = 0;
+			shelf_y += shelf_height;
+			shelf_height = 0;
+		}
+
+		icon->x = shelf_x;
+		icon->y = shelf_y;
+
+		shelf_x += icon->width;
+		if (icon->height > shelf_height) {
+			shelf_height = icon->height;
+		}
 	}
 
-	icon->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, SVG_SURFACE_WIDTH, SVG_SURFACE_HEIGHT);
-	icon->context = cairo_create(icon->surface);
+	// second pass: rasterize into the atlas
+	// cairo refuses to create empty surfaces, so keep at least one row
+	atlas = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, atlas_width, shelf_y + shelf_height + 1);
+	cr = cairo_create(atlas);
+
+	for (i = 0; i < ICON_COUNT; i++) {
+		if (!handles[i]) {
+			continue;
+		}
 
-	rsvg_handle_get_intrinsic_size_in_pixels(icon->handle, &svg_width, &svg_height);
+		icon = (struct icon *)((char *)resources + icon_files[i].offset);
+		viewport.x = icon->x;
+		viewport.y = icon->y;
+		viewport.width = icon->width;
+		viewport.height = icon->height;
+
+		if (!rsvg_handle_render_document(handles[i], cr, &viewport, &error)) {
+			fprintf(stderr, "Could not render svg: %s\n", error->message);
+			g_error_free(error);
+			error = NULL;
+			// don't leave a stale rectangle behind for this icon
+			icon->width = 0;
+			icon->height = 0;
+		}
 
-	icon->viewport.x = 0;
-	icon->viewport.y = 0;
-	icon->viewport.width = svg_width;
-	icon->viewport.height = svg_height;
+		g_object_unref(handles[i]);
+	}
+
+	cairo_destroy(cr);
+	cairo_surface_flush(atlas);
+
+	return atlas;
 }
 
-struct Drwl *drwl_create(const char *font) {
-	struct Drwl *drwl;
+// Shapes every printable ascii character on its own. Characters that
+// pango draws with a fallback font or as several glyphs are left out.
+static struct glyph_cache *glyph_cache_create(struct font_conf *font) {
+	struct glyph_cache *cache;
+	struct glyph *glyph;
+	PangoLayout *layout;
+	PangoLayoutLine *line;
+	PangoLayoutRun *run;
+	PangoFont *primary = NULL;
+	cairo_scaled_font_t *scaled_font;
+	char text[2] = { 0 };
+	int c;
+
+	cache = calloc(1, sizeof(struct glyph_cache));
+	if (!cache) {
+		fprintf(stderr, "Failed to allocate memory for glyph cache\n");
+		return NULL;
+	}
+
+	layout = pango_layout_new(font->context);
+	pango_layout_set_font_description(layout, font->desc);
+
+	for (c = GLYPH_FIRST; c <= GLYPH_LAST; c++) {
+		text[0] = (char)c;
+		pango_layout_set_text(layout, text, 1);
+
+		line = pango_layout_get_line_readonly(layout, 0);
+		if (!line || !line->runs || line->runs->next) {
+			continue;
+		}
+
+		run = line->runs->data;
+		if (run->glyphs->num_glyphs != 1 || run->glyphs->glyphs[0].glyph & PANGO_GLYPH_UNKNOWN_FLAG) {
+			continue;
+		}
+
+		// every glyph has to come from the same font to share one scaled font
+		if (!primary) {
+			primary = run->item->analysis.font;
+			scaled_font = pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(primary));
+			if (!scaled_font) {
+				break;
+			}
+			cache->scaled_font = cairo_scaled_font_reference(scaled_font);
+			cache->baseline = (double)pango_layout_get_baseline(layout) / PANGO_SCALE;
+		} else if (run->item->analysis.font != primary) {
+			continue;
+		}
+
+		glyph = &cache->glyphs[c - GLYPH_FIRST];
+		glyph->index = run->glyphs->glyphs[0].glyph;
+		glyph->advance = run->glyphs->glyphs[0].geometry.width;
+		glyph->usable = 1;
+	}
+
+	g_object_unref(layout);
+
+	if (!cache->scaled_font) {
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+static void glyph_cache_destroy(struct glyph_cache *cache) {
+	cairo_scaled_font_destroy(cache->scaled_font);
+	free(cache);
+}
+
+// Returns 1 if every character of text can be drawn from the glyph cache
+static int glyph_cache_covers(struct glyph_cache *cache, const char *text) {
+	const unsigned char *c;
+
+	if (!cache) {
+		return 0;
+	}
+
+	for (c = (const unsigned char *)text; *c; c++) {
+		if (c - (const unsigned char *)text >= GLYPH_RUN_MAX) {
+			return 0;
+		}
+		if (*c < GLYPH_FIRST || *c > GLYPH_LAST || !cache->glyphs[*c - GLYPH_FIRST].usable) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int glyph_cache_width(struct glyph_cache *cache, const char *text) {
+	const unsigned char *c;
+	int width = 0;
+
+	for (c = (const unsigned char *)text; *c; c++) {
+		width += cache->glyphs[*c - GLYPH_FIRST].advance;
+	}
+
+	// round up like the logical extents of a layout
+	return (width + PANGO_SCALE - 1) / PANGO_SCALE;
+}
+
+static void glyph_cache_render(cairo_t *cr, struct glyph_cache *cache, int x, int y, const char *text) {
+	cairo_glyph_t glyphs[GLYPH_RUN_MAX];
+	const unsigned char *c;
+	struct glyph *glyph;
+	int advance = 0;
+	int count = 0;
+
+	for (c = (const unsigned char *)text; *c; c++) {
+		glyph = &cache->glyphs[*c - GLYPH_FIRST];
+		glyphs[count].index = glyph->index;
+		glyphs[count].x = x + (double)advance / PANGO_SCALE;
+		glyphs[count].y = y + cache->baseline;
+		advance += glyph->advance;
+		count++;
+	}
+
+	cairo_set_scaled_font(cr, cache->scaled_font);
+	cairo_show_glyphs(cr, glyphs, count);
+}
+
+// every font currently in use by at least one monitor
+static struct drwl_resources *resources_cache;
+
+static struct drwl_resources *resources_create(const char *font, float scale, int fast_text) {
+	struct drwl_resources *resources;
 	struct font_conf *font_conf;
 	// this variable is for getting the font height
 	// this is for calculating parts of the bar prior
@@ -498,191 +638,433 @@ struct Drwl *drwl_create(const char *font) {
 	PangoFontMap *font_map;
 	PangoFontMetrics *metrics;
 	float font_height;
-	
-	drwl = calloc(1, sizeof(struct Drwl));
-	if (!drwl) {
-		fprintf(stderr, "Failed to allocate memory for status bar\n");
+
+	resources = calloc(1, sizeof(struct drwl_resources));
+	if (!resources) {
+		fprintf(stderr, "Failed to allocate memory for statusbar resources\n");
 		return NULL;
 	}
 
-	font_conf = calloc(1, sizeof(struct font_conf));
-	if (!font_conf) {
-		fprintf(stderr, "Failed to allocate memory for font_conf\n");
-		free(drwl);
+	resources->font_name = strdup(font);
+	if (!resources->font_name) {
+		fprintf(stderr, "Failed to allocate memory for font name\n");
+		free(resources);
 		return NULL;
 	}
 
+	font_conf = &resources->font;
+	font_conf->scale = scale;
+
 	// Create a pango context from default cairo font map
 	font_map = pango_cairo_font_map_get_default();
 	font_conf->context = pango_font_map_create_context(font_map);
+	// rasterize at the output's scale instead of having
+	// the compositor stretch the bar every frame
+	pango_cairo_context_set_resolution(font_conf->context, 96.0 * scale);
 
 	font_conf->desc = pango_font_description_from_string(font);
 	// Get font metrics and use the metrics to get the font height
 	metrics = pango_context_get_metrics(font_conf->context, font_conf->desc, NULL);
 	font_height = (float)pango_font_metrics_get_height(metrics) / (float)PANGO_SCALE;
 	font_conf->height = (unsigned int)font_height;
+	pango_font_metrics_unref(metrics);
 
-	// load all the icons necessary for wireless networks
-	load_icon(ADWAITA_THEME_DIR "/status/network-wireless-disabled-symbolic.svg", &drwl->wireless.disconnected);
-	load_icon(ADWAITA_THEME_DIR "/status/network-wireless-signal-good-symbolic.svg", &drwl->wireless.good);
-	load_icon(ADWAITA_THEME_DIR "/status/network-wireless-signal-ok-symbolic.svg", &drwl->wireless.okay);
-	load_icon(ADWAITA_THEME_DIR "/status/network-wireless-signal-weak-symbolic.svg", &drwl->wireless.weak);
-	load_icon(ADWAITA_THEME_DIR "/status/network-wireless-signal-none-symbolic.svg", &drwl->wireless.none);
-
-	// load all the icons necessary for the battery
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-10-charging-symbolic.svg", &drwl->battery.charging._10);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-20-charging-symbolic.svg", &drwl->battery.charging._20);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-30-charging-symbolic.svg", &drwl->battery.charging._30);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-40-charging-symbolic.svg", &drwl->battery.charging._40);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-50-charging-symbolic.svg", &drwl->battery.charging._50);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-60-charging-symbolic.svg", &drwl->battery.charging._60);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-70-charging-symbolic.svg", &drwl->battery.charging._70);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-80-charging-symbolic.svg", &drwl->battery.charging._80);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-90-charging-symbolic.svg", &drwl->battery.charging._90);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-100-charged-symbolic.svg", &drwl->battery.charging._100);
-
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-0-symbolic.svg", &drwl->battery.discharging._0);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-10-symbolic.svg", &drwl->battery.discharging._10);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-20-symbolic.svg", &drwl->battery.discharging._20);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-30-symbolic.svg", &drwl->battery.discharging._30);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-40-symbolic.svg", &drwl->battery.discharging._40);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-50-symbolic.svg", &drwl->battery.discharging._50);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-60-symbolic.svg", &drwl->battery.discharging._60);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-70-symbolic.svg", &drwl->battery.discharging._70);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-80-symbolic.svg", &drwl->battery.discharging._80);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-90-symbolic.svg", &drwl->battery.discharging._90);
-	load_icon(ADWAITA_THEME_DIR "/status/battery-level-100-symbolic.svg", &drwl->battery.discharging._100);
+	if (fast_text) {
+		font_conf->glyphs = glyph_cache_create(font_conf);
+	}
 
-	pango_font_metrics_unref(metrics);
+	// rasterize all the icons necessary for wireless networks & battery
+	resources->atlas = create_icon_atlas(resources);
+
+	return resources;
+}
+
+static void resources_destroy(struct drwl_resources *resources) {
+	struct shaped_text *entry;
+	int i;
 
-	drwl->font = font_conf;
+	for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+		entry = &resources->font.text_cache[i];
+		if (entry->layout) {
+			g_object_unref(entry->layout);
+		}
+		free(entry->text);
+	}
+
+	if (resources->font.glyphs) {
+		glyph_cache_destroy(resources->font.glyphs);
+	}
+
+	pango_font_description_free(resources->font.desc);
+	g_object_unref(resources->font.context);
+
+	cairo_surface_destroy(resources->atlas);
+
+	free(resources->font_name);
+	free(resources);
+}
+
+static struct drwl_resources *resources_acquire(const char *font, float scale, int fast_text) {
+	struct drwl_resources *resources;
+
+	// monitors share resources if they use the same font at the same scale
+	for (resources = resources_cache; resources; resources = resources->next) {
+		if (strcmp(resources->font_name, font) == 0 && resources->font.scale == scale) {
+			resources->refcount++;
+			return resources;
+		}
+	}
+
+	resources = resources_create(font, scale, fast_text);
+	if (!resources) {
+		return NULL;
+	}
+
+	resources->refcount = 1;
+	resources->next = resources_cache;
+	resources_cache = resources;
+
+	return resources;
+}
+
+static void resources_release(struct drwl_resources *resources) {
+	struct drwl_resources **link;
+
+	if (--resources->refcount) {
+		return;
+	}
+
+	for (link = &resources_cache; *link; link = &(*link)->next) {
+		if (*link == resources) {
+			*link = resources->next;
+			break;
+		}
+	}
+
+	resources_destroy(resources);
+}
+
+struct Drwl *drwl_create(const char *font, float scale, int fast_text) {
+	struct Drwl *drwl;
+
+	drwl = calloc(1, sizeof(struct Drwl));
+	if (!drwl) {
+		fprintf(stderr, "Failed to allocate memory for status bar\n");
+		return NULL;
+	}
+
+	drwl->fast_text = fast_text;
+
+	// every monitor after the first one gets this for free
+	drwl->resources = resources_acquire(font, scale, fast_text);
+	if (!drwl->resources) {
+		free(drwl);
+		return NULL;
+	}
+
+	drwl->font = &drwl->resources->font;
 
 	return drwl;
 }
 
-void drwl_prepare_drawing(struct Drwl *drwl, int w, int h, int stride, unsigned char *data) {
-	// create all the necessary information to write to the wayland buffer
-	drwl->surface = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, w, h, stride);
-	drwl->context = cairo_create(drwl->surface);
+int drwl_set_scale(struct Drwl *drwl, float scale) {
+	struct drwl_resources *resources;
+
+	if (drwl->font->scale == scale) {
+		return 0;
+	}
+
+	resources = resources_acquire(drwl->resources->font_name, scale, drwl->fast_text);
+	if (!resources) {
+		return 1;
+	}
+
+	resources_release(drwl->resources);
+	drwl->resources = resources;
+	drwl->font = &resources->font;
+
+	// nothing drawn at the old scale can be kept
+	if (drwl->surface) {
+		cairo_destroy(drwl->context);
+		cairo_surface_destroy(drwl->surface);
+		drwl->surface = NULL;
+		drwl->context = NULL;
+	}
+
+	return 0;
+}
+
+// cairo may still have drawing queued up for the surface
+static void fill_begin(struct Drwl *drwl) {
+	cairo_surface_flush(drwl->surface);
+}
+
+// tells cairo the pixels changed behind its back
+static void fill_end(struct Drwl *drwl, int x, int y, int w, int h) {
+	cairo_surface_mark_dirty_rectangle(drwl->surface, x, y, w, h);
+}
 
-	drwl->font->layout = pango_layout_new(drwl->font->context);
-	pango_layout_set_font_description(drwl->font->layout, drwl->font->desc);
+static void fill_clip(struct Drwl *drwl, int x, int width) {
+	drwl->target.clip.x1 = x < 0 ? 0 : x;
+	drwl->target.clip.x2 = x + width > drwl->target.width ? drwl->target.width : x + width;
+	drwl->target.clip.y1 = 0;
+	drwl->target.clip.y2 = drwl->target.height;
 }
 
-void delineate_rect(cairo_t *cr, int x, int y, int w, int h) {
-	cairo_antialias_t aa = cairo_get_antialias(cr);
-	cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+static void add_damage(struct Drwl *drwl, int x, int width) {
+	int capacity = sizeof(drwl->damage) / sizeof(drwl->damage[0]);
+	struct damage_span *span;
+	int right;
+
+	if (width <= 0) {
+		return;
+	}
 
-	cairo_set_line_width(cr, 1.0);
+	if (drwl->damage_count < capacity) {
+		span = &drwl->damage[drwl->damage_count++];
+		span->x = x;
+		span->width = width;
+		return;
+	}
+
+	// out of room, grow the last span to cover this one as well
+	span = &drwl->damage[capacity - 1];
+	right = span->x + span->width > x + width ? span->x + span->width : x + width;
+	span->x = span->x < x ? span->x : x;
+	span->width = right - span->x;
+}
+
+static void clear_span(struct Drwl *drwl, int x, int width) {
+	if (width <= 0) {
+		return;
+	}
 
-	cairo_rectangle(cr, x + 1, y + 1, w - 1, h - 1);
-	cairo_stroke(cr);
+	fill_begin(drwl);
+	fill_rect(&drwl->target, x, 0, width, drwl->target.height, drwl->background, FillSource);
+	fill_end(drwl, x, 0, width, drwl->target.height);
 
-	cairo_set_antialias(cr, aa);
+	add_damage(drwl, x, width);
 }
 
-void filled_rect(cairo_t *cr, int x, int y, int w, int h) {
-	cairo_rectangle(cr, x, y, w, h);
-	cairo_fill(cr);
+void drwl_prepare_drawing(struct Drwl *drwl, int w, int h, uint32_t background) {
+	int resized = !drwl->surface
+		|| cairo_image_surface_get_width(drwl->surface) != w
+		|| cairo_image_surface_get_height(drwl->surface) != h;
+	int i;
+
+	drwl->damage_count = 0;
+
+	if (resized) {
+		if (drwl->surface) {
+			cairo_destroy(drwl->context);
+			cairo_surface_destroy(drwl->surface);
+		}
+
+		// this surface outlives the frame, only dirty segments are
+		// painted over. the wayland buffer is filled from it
+		drwl->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+		drwl->context = cairo_create(drwl->surface);
+
+		drwl->target.pixels = (uint32_t *)cairo_image_surface_get_data(drwl->surface);
+		drwl->target.stride = cairo_image_surface_get_stride(drwl->surface) / 4;
+		drwl->target.width = w;
+		drwl->target.height = h;
+		fill_clip(drwl, 0, w);
+	}
+
+	// every segment is cleared to the background,
+	// so changing it means painting everything again
+	if (resized || drwl->background != background) {
+		drwl->background = background;
+		for (i = 0; i < SegLast; i++) {
+			drwl->segments[i].valid = 0;
+		}
+		clear_span(drwl, 0, w);
+	}
+
+	for (i = 0; i < SegLast; i++) {
+		drwl->segments[i].dirty = 0;
+	}
 }
 
-void filled_rounded_rect(cairo_t *cr, int x, int y, int w, int h,
-		double radius) {
-	cairo_new_sub_path(cr);
-	cairo_arc(cr, x + w - radius, y + radius, radius, DEG_TO_RAD(-90), 0);
-	cairo_arc(cr, x + w - radius, y + h - radius, radius, 0, DEG_TO_RAD(90));
-	cairo_arc(cr, x + radius, y + h - radius, radius, DEG_TO_RAD(90), DEG_TO_RAD(180));
-	cairo_arc(cr, x + radius, y + radius, radius, DEG_TO_RAD(180), DEG_TO_RAD(270));
-	cairo_close_path(cr);
+// FNV-1a, only used to notice that a segment changed
+uint32_t drwl_hash(uint32_t hash, const void *data, size_t len) {
+	const unsigned char *bytes = data;
+	size_t i;
 
-	cairo_fill(cr);
+	for (i = 0; i < len; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
 }
 
-void render_icon(cairo_t *cr, struct icon *icon, double x, double y) {
-	GError *error = NULL;
+// hashes the colors a scheme is drawn with
+uint32_t drwl_hash_scheme(uint32_t hash, const struct color *scheme) {
+	hash = drwl_hash(hash, &scheme[ColFg].pixel, sizeof(uint32_t));
+	return drwl_hash(hash, &scheme[ColBg].pixel, sizeof(uint32_t));
+}
+
+// Moves a segment and marks it dirty if anything about it changed.
+// Every segment has to be set before any of them are painted, otherwise
+// clearing the old position of one segment could wipe out another one.
+void drwl_segment_set(struct Drwl *drwl, enum bar_segment seg, int x, int width, uint32_t hash) {
+	struct segment *segment = &drwl->segments[seg];
+
+	if (segment->valid && segment->x == x && segment->width == width && segment->hash == hash) {
+		return;
+	}
+
+	// whatever is at the old position doesn't belong to anyone anymore
+	if (segment->valid) {
+		clear_span(drwl, segment->x, segment->width);
+	}
+	clear_span(drwl, x, width);
+
+	segment->x = x;
+	segment->width = width;
+	segment->hash = hash;
+	segment->valid = 1;
+	segment->dirty = 1;
+}
+
+// Returns 1 if the segment has to be painted. Painting is clipped
+// to the segment, drwl_segment_end() must be called afterwards.
+int drwl_segment_begin(struct Drwl *drwl, enum bar_segment seg) {
+	struct segment *segment = &drwl->segments[seg];
+
+	if (!segment->dirty || segment->width <= 0) {
+		return 0;
+	}
+
+	cairo_save(drwl->context);
+	cairo_rectangle(drwl->context, segment->x, 0, segment->width, drwl->target.height);
+	cairo_clip(drwl->context);
+	fill_clip(drwl, segment->x, segment->width);
+
+	return 1;
+}
+
+void drwl_segment_end(struct Drwl *drwl) {
+	cairo_restore(drwl->context);
+	fill_clip(drwl, 0, drwl->target.width);
+}
+
+void delineate_rect(struct Drwl *drwl, int x, int y, int w, int h, const struct color *color) {
+	fill_begin(drwl);
+	fill_outline(&drwl->target, x, y, w, h, color->pixel);
+	fill_end(drwl, x, y, w, h);
+}
+
+void filled_rect(struct Drwl *drwl, int x, int y, int w, int h, const struct color *color) {
+	fill_begin(drwl);
+	fill_rect(&drwl->target, x, y, w, h, color->pixel, FillOver);
+	fill_end(drwl, x, y, w, h);
+}
 
-	if (!rsvg_handle_render_document(icon->handle, icon->context, &icon->viewport, &error)) {
-		fprintf(stderr, "Could not render svg: %s\n", error->message);
+void filled_rounded_rect(struct Drwl *drwl, int x, int y, int w, int h,
+		int radius, const struct color *color) {
+	fill_begin(drwl);
+	fill_rounded_rect(&drwl->target, x, y, w, h, radius, color->pixel);
+	fill_end(drwl, x, y, w, h);
+}
+
+void render_icon(cairo_t *cr, cairo_surface_t *atlas, struct icon *icon, int x, int y, int tint) {
+	if (icon->width == 0 || icon->height == 0) {
 		return;
 	}
 
-	// render surface to target context
-	cairo_set_source_surface(cr, icon->surface, x, 0);
-	cairo_paint(cr);
+	cairo_save(cr);
+	cairo_rectangle(cr, x, y, icon->width, icon->height);
+	cairo_clip(cr);
+	if (tint) {
+		// only the alpha of the icon is kept, in the current source color
+		cairo_mask_surface(cr, atlas, x - icon->x, y - icon->y);
+	} else {
+		cairo_set_source_surface(cr, atlas, x - icon->x, y - icon->y);
+		cairo_paint(cr);
+	}
+	cairo_restore(cr);
+}
+
+// Returns the layout for text, shaping it only if it isn't cached yet.
+// The layouts are only ever used from the compositor thread,
+// so every monitor using the font can share them.
+static struct shaped_text *shape_text(struct font_conf *font, const char *text) {
+	struct shaped_text *entry, *oldest = &font->text_cache[0];
+	PangoRectangle extent;
+	int i;
+
+	font->text_clock++;
+
+	for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+		entry = &font->text_cache[i];
+		if (entry->text && strcmp(entry->text, text) == 0) {
+			entry->last_used = font->text_clock;
+			return entry;
+		}
+
+		if (!entry->text || (oldest->text && entry->last_used < oldest->last_used)) {
+			oldest = entry;
+		}
+	}
+
+	// the least recently used layout is shaped again with the new text
+	entry = oldest;
+	if (!entry->layout) {
+		entry->layout = pango_layout_new(font->context);
+		pango_layout_set_font_description(entry->layout, font->desc);
+	}
+
+	free(entry->text);
+	entry->text = strdup(text);
+	entry->last_used = font->text_clock;
+
+	pango_layout_set_text(entry->layout, text, -1);
+	pango_layout_get_pixel_extents(entry->layout, NULL, &extent);
+	entry->width = extent.width;
+
+	return entry;
 }
 
 void render_text(cairo_t *cr, struct font_conf *font, int x, int y, const char *text) {
-	pango_layout_set_text(font->layout, text, -1);
+	struct shaped_text *entry;
+
+	if (glyph_cache_covers(font->glyphs, text)) {
+		glyph_cache_render(cr, font->glyphs, x, y, text);
+		return;
+	}
+
+	entry = shape_text(font, text);
 
 	cairo_move_to(cr, x, y);
-	pango_cairo_show_layout(cr, font->layout);
+	pango_cairo_show_layout(cr, entry->layout);
 }
 
 unsigned int drwl_font_getwidth(struct Drwl *drwl, const char *text) {
-	PangoRectangle extent;
-	pango_layout_set_text(drwl->font->layout, text, -1);
-	pango_layout_get_extents(drwl->font->layout, NULL, &extent);
-	return (unsigned int)extent.width / PANGO_SCALE;
+	return (unsigned int)text_width(drwl->font, text);
 }
 
 int text_width(struct font_conf *font, const char *text) {
-	PangoRectangle extent;
-	pango_layout_set_text(font->layout, text, -1);
-	pango_layout_get_pixel_extents(font->layout, NULL, &extent);
-	return extent.width;
-}
+	if (glyph_cache_covers(font->glyphs, text)) {
+		return glyph_cache_width(font->glyphs, text);
+	}
 
-void drwl_finish_drawing(struct Drwl *drwl) {
-	g_object_unref(drwl->font->layout);
-	cairo_destroy(drwl->context);
-	cairo_surface_destroy(drwl->surface);
+	return shape_text(font, text)->width;
 }
 
-void destroy_icon(struct icon *icon) {
-	cairo_destroy(icon->context);
-	cairo_surface_destroy(icon->surface);
-	g_object_unref(icon->handle);
+void drwl_finish_drawing(struct Drwl *drwl) {
+	// make sure everything hit the pixels before they are copied out
+	cairo_surface_flush(drwl->surface);
 }
 
 void drwl_destroy(struct Drwl *drwl) {
-	pango_font_description_free(drwl->font->desc);
-
-	g_object_unref(drwl->font->context);
-
-	// TODO
-	// yknow I could probably do this more graciously
-	// like making a list of icons.
-	// but also I am lazy currently. I will do it later
-	//
-	// "Implement it first. Then fix the issues."
-	destroy_icon(&drwl->wireless.disconnected);
-	destroy_icon(&drwl->wireless.good);
-	destroy_icon(&drwl->wireless.okay);
-	destroy_icon(&drwl->wireless.weak);
-	destroy_icon(&drwl->wireless.none);
-
-	destroy_icon(&drwl->battery.charging._10);
-	destroy_icon(&drwl->battery.charging._20);
-	destroy_icon(&drwl->battery.charging._30);
-	destroy_icon(&drwl->battery.charging._40);
-	destroy_icon(&drwl->battery.charging._50);
-	destroy_icon(&drwl->battery.charging._60);
-	destroy_icon(&drwl->battery.charging._70);
-	destroy_icon(&drwl->battery.charging._80);
-	destroy_icon(&drwl->battery.charging._90);
-	destroy_icon(&drwl->battery.charging._100);
-
-	destroy_icon(&drwl->battery.discharging._0);
-	destroy_icon(&drwl->battery.discharging._20);
-	destroy_icon(&drwl->battery.discharging._30);
-	destroy_icon(&drwl->battery.discharging._40);
-	destroy_icon(&drwl->battery.discharging._50);
-	destroy_icon(&drwl->battery.discharging._60);
-	destroy_icon(&drwl->battery.discharging._70);
-	destroy_icon(&drwl->battery.discharging._80);
-	destroy_icon(&drwl->battery.discharging._90);
-	destroy_icon(&drwl->battery.discharging._100);
-
-	free(drwl->font);
+	if (drwl->surface) {
+		cairo_destroy(drwl->context);
+		cairo_surface_destroy(drwl->surface);
+	}
+
+	resources_release(drwl->resources);
 	free(drwl);
 }
@@ -34,6 +34,8 @@
 #include <librsvg/rsvg.h>
 #include <linux/wireless.h>
 
+#include "fill.h"
+
 // undefine max & min.
 // suppresses redefinition warning
 // dwl has it's own implementation
@@ -71,11 +73,11 @@ enum battery_status {
 	Inhibited
 };
 
+// an icon is a sub-rectangle of the icon atlas.
+// every icon is rasterized once in drwl_create()
 struct icon {
-	RsvgHandle *handle;
-	cairo_surface_t *surface;
-	cairo_t *context;
-	RsvgRectangle viewport;
+	int x, y;
+	int width, height;
 };
 
 struct wireless_icons {
@@ -123,7 +125,8 @@ struct battery_icons {
 
 struct network_info {
 	enum network_type type;
-	char name[IW_ESSID_MAX_SIZE];
+	// essid of a wireless network, interface name of a wired one
+	char name[IW_ESSID_MAX_SIZE + 1];
 	int quality;
 };
 
@@ -159,17 +162,61 @@ struct system_info {
 	struct time_info date;
 };
 
+#define TEXT_CACHE_SIZE 32
+
+// a string that was already shaped, see shape_text()
+struct shaped_text {
+	char *text;
+	PangoLayout *layout;
+	int width;
+	// text_clock of the last lookup, the oldest entry is reused first
+	unsigned int last_used;
+};
+
+// printable ascii, the only characters the glyph cache draws
+#define GLYPH_FIRST (0x20)
+#define GLYPH_LAST (0x7e)
+// longer strings are left to pango
+#define GLYPH_RUN_MAX (128)
+
+struct glyph {
+	unsigned long index;
+	// in pango units
+	int advance;
+	// 0 when the character needs a fallback font
+	int usable;
+};
+
+// Status strings are mostly ascii digits & punctuation, so their glyphs
+// are shaped once and drawn without going through a layout. The masks
+// are rasterized once by cairo and kept in the scaled font's glyph cache.
+// Anything else still goes through pango, see shape_text()
+struct glyph_cache {
+	cairo_scaled_font_t *scaled_font;
+	// distance from the top of the text to the baseline
+	double baseline;
+	struct glyph glyphs[GLYPH_LAST - GLYPH_FIRST + 1];
+};
+
 struct font_conf {
 	PangoContext *context;
 	PangoFontDescription *desc;
+	// in pixels at scale
 	unsigned int height;
-	PangoLayout *layout;
+	// output scale everything is rasterized at
+	float scale;
+
+	// NULL if disabled, see drwl_create()
+	struct glyph_cache *glyphs;
+
+	// tag names and status strings rarely change between redraws,
+	// so they are only shaped again when their bytes change
+	struct shaped_text text_cache[TEXT_CACHE_SIZE];
+	unsigned int text_clock;
 };
 
 struct statusbar {
-	// used for updating system info struct every 45 seconds
-	struct wl_event_source *timed_event_source;
-
+	// kept up to date by the collector, see collector.h
 	struct system_info system_info;
 
 	// all statusbar panels get written to here.
@@ -177,37 +224,153 @@ struct statusbar {
 	cairo_t *context;
 };
 
+// A color of a scheme, decoded once into every form it is drawn with.
+// see color_init() and loadcolors() in dwl.c
+struct color {
+	// 0xRRGGBBAA, as written in config.h
+	uint32_t hex;
+	// premultiplied ARGB32 for the span fills, see fill_pixel()
+	uint32_t pixel;
+	// straight alpha for the scene graph (borders)
+	float rgba[4];
+	// source for text & icons
+	cairo_pattern_t *pattern;
+};
+
+// The bar is split into segments. A segment is only repainted
+// when its position or the state it displays changes.
+enum bar_segment {
+	SegTags,
+	SegTitle,
+	// status panels, right to left
+	SegDate,
+	SegBattery,
+	SegTemp,
+	SegMemory,
+	SegNetwork,
+	SegLast
+};
+
+struct segment {
+	int x, width;
+	// hash of everything the segment displays
+	uint32_t hash;
+	int valid;
+	// set by drwl_segment_set() when the segment has to be repainted
+	int dirty;
+};
+
+// horizontal span of the bar that changed, the bar is a single row
+struct damage_span {
+	int x, width;
+};
+
+#define DRWL_HASH_INIT (2166136261u)
+
+// Font and icon state is identical for every monitor using the same font,
+// so it is created once and reference counted. see drwl_create()
+struct drwl_resources {
+	char *font_name;
+	unsigned int refcount;
+
+	struct font_conf font;
+
+	struct icon wired;
+	struct wireless_icons wireless;
+	struct battery_icons battery;
+
+	// all icons packed into a single ARGB32 surface
+	cairo_surface_t *atlas;
+
+	struct drwl_resources *next;
+};
+
 // TODO rename Drwl to something like statusbar?
 // Plus make it not a typedef. That is confusing.
+// This is the per monitor view of the shared resources.
 struct Drwl {
-	struct wireless_icons wireless;
-	struct battery_icons battery;
+	struct drwl_resources *resources;
 
+	// shorthand for &resources->font
 	struct font_conf *font;
+	// see drwl_set_scale()
+	int fast_text;
 
+	// persistent pixel contents of the bar. only dirty
+	// segments are repainted, everything else is kept
 	cairo_surface_t *surface;
 	cairo_t *context;
 
-	uint32_t *scheme;
+	const struct color *scheme;
+
+	// the pixels of surface, for the flat primitives. clipped to
+	// the segment being painted, see drwl_segment_begin()
+	struct fill_target target;
+
+	// pixel every segment is cleared to before painting
+	uint32_t background;
+	struct segment segments[SegLast];
+
+	// spans repainted since drwl_prepare_drawing()
+	// every segment can damage its old and its new position
+	struct damage_span damage[SegLast * 2];
+	int damage_count;
 };
 
-void formatstatusbar(struct system_info *info);
+// Everything the bar shows besides the status panels, see drwl_draw_bar()
+struct bar_state {
+	char *const *tags;
+	int tag_count;
+	// one bit per tag: shown, has clients, has urgent clients
+	// and holds the focused client of the selected monitor
+	uint32_t tagset, occupied, urgent, focused;
+	// of the focused client, NULL if there is none
+	const char *title;
+	// only hashed, tells clients with the same title apart
+	const void *client;
+	// the monitor is selmon, the status is only drawn there
+	int selected;
+	int lrpad;
+	const struct color *norm, *sel;
+};
+
+void color_init(struct color *color, uint32_t hex);
+
+void color_finish(struct color *color);
+
+void set_color(cairo_t *cr, const struct color *color);
+
+int layout_system_info(struct Drwl *drwl, struct system_info *info, int x, int visible);
+
+void draw_system_info(struct Drwl *drwl, struct system_info *info, int y);
 
-void set_color(cairo_t *cr, uint32_t hex);
+void drwl_draw_bar(struct Drwl *drwl, struct system_info *info, const struct bar_state *bar, int width, int height);
 
-int draw_system_info(struct Drwl *drwl, struct system_info *info, int x, int y);
+struct Drwl *drwl_create(const char *font, float scale, int fast_text);
 
-struct Drwl *drwl_create(const char *font);
+// switches to the resources of another output scale, returns 0 on success
+int drwl_set_scale(struct Drwl *drwl, float scale);
 
-void drwl_prepare_drawing(struct Drwl *drwl, int w, int h, int stride, unsigned char *data);
+void drwl_prepare_drawing(struct Drwl *drwl, int w, int h, uint32_t background);
 
-void delineate_rect(cairo_t *cr, int x, int y, int w, int h);
+uint32_t drwl_hash(uint32_t hash, const void *data, size_t len);
 
-void filled_rect(cairo_t *cr, int x, int y, int w, int h);
+uint32_t drwl_hash_scheme(uint32_t hash, const struct color *scheme);
 
-void filled_rounded_rect(cairo_t *cr, int x, int y, int w, int h, double radius);
+void drwl_segment_set(struct Drwl *drwl, enum bar_segment seg, int x, int width, uint32_t hash);
 
-void render_icon(cairo_t *cr, struct icon *icon, double x, double y);
+int drwl_segment_begin(struct Drwl *drwl, enum bar_segment seg);
+
+void drwl_segment_end(struct Drwl *drwl);
+
+void delineate_rect(struct Drwl *drwl, int x, int y, int w, int h, const struct color *color);
+
+void filled_rect(struct Drwl *drwl, int x, int y, int w, int h, const struct color *color);
+
+void filled_rounded_rect(struct Drwl *drwl, int x, int y, int w, int h, int radius, const struct color *color);
+
+// draws the icon in its own colors, or with tint set, in the current source
+void render_icon(cairo_t *cr, cairo_surface_t *atlas, struct icon *icon, int x, int y, int tint);
 
 void render_text(cairo_t *cr, struct font_conf *font, int x, int y, const char *text);
 
@@ -215,6 +378,4 @@ int text_width(struct font_conf *font, const char *text);
 
 void drwl_finish_drawing(struct Drwl *drwl);
 
-void destroy_icon(struct icon *icon);
-
 void drwl_destroy(struct Drwl *drwl);
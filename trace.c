@@ -0,0 +1,193 @@
+#include "trace.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static struct trace_event *ring;
+// events recorded so far, the newest is ring[(count - 1) % TRACE_RING]
+static uint64_t count;
+
+static char *trace_path;
+static struct wl_event_source *signal_source;
+
+static char track_names[TRACE_TRACKS][TRACE_TRACK_NAME_MAX] = { "main" };
+// released tracks keep their name, see trace_track_release()
+static int track_used[TRACE_TRACKS] = { 1 };
+static int track_count = 1;
+
+static uint64_t now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static struct trace_event *next_event(void) {
+	return &ring[count++ % TRACE_RING];
+}
+
+static int signal_in(int signal_number, void *data) {
+	if (trace_write() == 0) {
+		fprintf(stderr, "trace written to %s\n", trace_path);
+	}
+	return 0;
+}
+
+int trace_start(struct wl_event_loop *loop, const char *path) {
+	ring = calloc(TRACE_RING, sizeof(*ring));
+	trace_path = strdup(path);
+	if (!ring || !trace_path) {
+		free(ring);
+		free(trace_path);
+		ring = NULL;
+		trace_path = NULL;
+		return 1;
+	}
+
+	signal_source = wl_event_loop_add_signal(loop, SIGUSR2, signal_in, NULL);
+	return 0;
+}
+
+void trace_stop(void) {
+	if (!ring) {
+		return;
+	}
+
+	if (signal_source) {
+		wl_event_source_remove(signal_source);
+		signal_source = NULL;
+	}
+	trace_write();
+	free(ring);
+	free(trace_path);
+	ring = NULL;
+	trace_path = NULL;
+}
+
+int trace_track(const char *name) {
+	char track_name[TRACE_TRACK_NAME_MAX], *c;
+	int track;
+
+	snprintf(track_name, sizeof(track_name), "%s", name);
+	// names go into JSON strings as they are
+	for (c = track_name; *c; c++) {
+		if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+			*c = '_';
+		}
+	}
+
+	// an output that comes back continues on its old track
+	for (track = 1; track < track_count; track++) {
+		if (!track_used[track] && strcmp(track_names[track], track_name) == 0) {
+			track_used[track] = 1;
+			return track;
+		}
+	}
+
+	if (track_count < TRACE_TRACKS) {
+		track = track_count++;
+	} else {
+		// events of the released track still in the ring get its new name
+		for (track = 1; track < TRACE_TRACKS; track++) {
+			if (!track_used[track]) {
+				break;
+			}
+		}
+		if (track == TRACE_TRACKS) {
+			return 0;
+		}
+	}
+
+	memcpy(track_names[track], track_name, sizeof(track_name));
+	track_used[track] = 1;
+	return track;
+}
+
+void trace_track_release(int track) {
+	if (track > 0) {
+		track_used[track] = 0;
+	}
+}
+
+void trace_span(const char *name, int track, uint64_t start, uint64_t end, uint64_t arg) {
+	struct trace_event *event;
+
+	if (!ring) {
+		return;
+	}
+
+	event = next_event();
+	event->start = start;
+	event->duration = end > start ? end - start : 0;
+	event->name = name;
+	event->arg = arg;
+	event->track = track;
+	event->instant = 0;
+}
+
+void trace_instant(const char *name, int track, uint64_t arg) {
+	struct trace_event *event;
+
+	if (!ring) {
+		return;
+	}
+
+	event = next_event();
+	event->start = now();
+	event->duration = 0;
+	event->name = name;
+	event->arg = arg;
+	event->track = track;
+	event->instant = 1;
+}
+
+int trace_write(void) {
+	const struct trace_event *event;
+	uint64_t i, first;
+	FILE *file;
+	int track;
+
+	if (!ring) {
+		return 1;
+	}
+
+	file = fopen(trace_path, "w");
+	if (!file) {
+		perror("trace: fopen");
+		return 1;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"dwl\"}}");
+	for (track = 0; track < track_count; track++) {
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+				"\"args\":{\"name\":\"%s\"}}", track, track_names[track]);
+	}
+
+	// oldest first, timestamps are in microseconds
+	first = count > TRACE_RING ? count - TRACE_RING : 0;
+	for (i = first; i < count; i++) {
+		event = &ring[i % TRACE_RING];
+		if (event->instant) {
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,"
+					"\"ts\":%.3f,\"args\":{\"value\":%llu}}", event->name, event->track,
+					event->start / 1e3, (unsigned long long)event->arg);
+		} else {
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+					"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"value\":%llu}}", event->name,
+					event->track, event->start / 1e3, event->duration / 1e3,
+					(unsigned long long)event->arg);
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	if (fclose(file) != 0) {
+		perror("trace: fclose");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+// events kept, the oldest ones are overwritten
+#define TRACE_RING (1 << 16)
+#define TRACE_TRACKS (16)
+#define TRACE_TRACK_NAME_MAX (32)
+
+// A flight recorder of compositor events, in -DPROBES builds with
+// DWL_TRACE=<file> set. The ring is allocated once by trace_start(), so
+// recording never allocates. It is written to the file in Chrome's JSON
+// trace format on SIGUSR2 and when dwl exits, to be opened with
+// ui.perfetto.dev or chrome://tracing.
+//
+// Every LISTEN() handler and PROBE_SCOPE() is a span on the main track,
+// see probes.h. Outputs get tracks of their own for their commits.
+struct trace_event {
+	uint64_t start;
+	// 0 for instant events
+	uint64_t duration;
+	// string literals only, they outlive the ring
+	const char *name;
+	uint64_t arg;
+	int track;
+	int instant;
+};
+
+#ifdef PROBES
+#define TRACE_INSTANT(name, arg) trace_instant((name), 0, (arg))
+#else
+#define TRACE_INSTANT(name, arg)
+#endif
+
+// returns 0 on success
+int trace_start(struct wl_event_loop *loop, const char *path);
+
+// writes the ring one last time and frees it
+void trace_stop(void);
+
+// a track named after name, which is copied. A released track of the same
+// name is reused, then any free one. 0, the main track, once every track
+// is taken
+int trace_track(const char *name);
+
+// frees a track of trace_track() for outputs created later
+void trace_track_release(int track);
+
+void trace_span(const char *name, int track, uint64_t start, uint64_t end, uint64_t arg);
+
+void trace_instant(const char *name, int track, uint64_t arg);
+
+// returns 0 on success
+int trace_write(void);
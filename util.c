@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "util.h"
 
@@ -39,13 +41,45 @@ int
 fd_set_nonblock(int fd) {
 	int flags = fcntl(fd, F_GETFL);
     if (flags < 0) {
-		perror("fcntl(F_GETFL):");
+		perror("fcntl(F_GETFL)");
         return -1;
     }
     if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
-		perror("fcntl(F_SETFL):");
+		perror("fcntl(F_SETFL)");
 		return -1;
     }
 
 	return 0;
 }
+
+void *
+shm_map(size_t size)
+{
+	static unsigned int serial;
+	char name[64];
+	void *p;
+	int fd;
+
+	/* The object is unlinked right away, only the mapping keeps it alive */
+	snprintf(name, sizeof(name), "/dwl-%ld-%u", (long)getpid(), serial++);
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+		perror("shm_open");
+		return NULL;
+	}
+	shm_unlink(name);
+
+	if (ftruncate(fd, size) < 0) {
+		perror("ftruncate");
+		close(fd);
+		return NULL;
+	}
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+
+	return p;
+}
@@ -3,3 +3,4 @@
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);
 int fd_set_nonblock(int fd);
+void *shm_map(size_t size);
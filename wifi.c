@@ -0,0 +1,353 @@
+#include "wifi.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+
+#ifndef SOL_NETLINK
+#define SOL_NETLINK (270)
+#endif
+
+// replies are a few hundred bytes, station dumps can be longer
+#define WIFI_BUFSIZ (8192)
+
+// a request is a header and a couple of small attributes
+struct wifi_request {
+	struct nlmsghdr nlh;
+	struct genlmsghdr genl;
+	char attrs[64];
+};
+
+// called for every reply to a request, see wifi_transact()
+typedef void (*wifi_handler)(struct nlattr **attrs, void *data);
+
+// covers the attributes of both nl80211 & the generic netlink controller
+#define WIFI_ATTR_MAX (NL80211_ATTR_MAX > CTRL_ATTR_MAX ? NL80211_ATTR_MAX : CTRL_ATTR_MAX)
+
+static int netlink_open(int protocol) {
+	struct sockaddr_nl addr = { 0 };
+	int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+	if (fd == -1) {
+		return -1;
+	}
+
+	addr.nl_family = AF_NETLINK;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void request_init(struct wifi_request *request, uint16_t family, uint8_t cmd, uint16_t flags) {
+	memset(request, 0, sizeof(*request));
+	request->nlh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+	request->nlh.nlmsg_type = family;
+	request->nlh.nlmsg_flags = NLM_F_REQUEST | flags;
+	request->genl.cmd = cmd;
+	request->genl.version = 1;
+}
+
+static void request_put(struct wifi_request *request, uint16_t type, const void *data, uint16_t len) {
+	struct nlattr *attr = (struct nlattr *)((char *)&request->nlh + NLMSG_ALIGN(request->nlh.nlmsg_len));
+
+	attr->nla_type = type;
+	attr->nla_len = NLA_HDRLEN + len;
+	memcpy((char *)attr + NLA_HDRLEN, data, len);
+	request->nlh.nlmsg_len = NLMSG_ALIGN(request->nlh.nlmsg_len) + NLA_ALIGN(attr->nla_len);
+}
+
+// Indexes a stream of attributes by type, unknown types are dropped
+static void parse_attrs(struct nlattr **table, int max, void *data, int len) {
+	struct nlattr *attr = data;
+	int type;
+
+	memset(table, 0, sizeof(*table) * (max + 1));
+
+	while (len >= NLA_HDRLEN && attr->nla_len >= NLA_HDRLEN && attr->nla_len <= len) {
+		type = attr->nla_type & NLA_TYPE_MASK;
+		if (type <= max) {
+			table[type] = attr;
+		}
+
+		len -= NLA_ALIGN(attr->nla_len);
+		attr = (struct nlattr *)((char *)attr + NLA_ALIGN(attr->nla_len));
+	}
+}
+
+static void *attr_data(struct nlattr *attr) {
+	return (char *)attr + NLA_HDRLEN;
+}
+
+static int attr_len(struct nlattr *attr) {
+	return attr->nla_len - NLA_HDRLEN;
+}
+
+// Sends a request and hands every reply to handler until the kernel
+// acknowledged it or finished the dump. returns 0 on success
+static int wifi_transact(struct wifi *wifi, struct wifi_request *request, wifi_handler handler, void *data) {
+	char buffer[WIFI_BUFSIZ];
+	struct nlattr *attrs[WIFI_ATTR_MAX + 1];
+	struct nlmsghdr *msg;
+	struct genlmsghdr *genl;
+	struct nlmsgerr *err;
+	ssize_t len;
+
+	request->nlh.nlmsg_seq = ++wifi->seq;
+	request->nlh.nlmsg_flags |= NLM_F_ACK;
+	if (send(wifi->fd, request, request->nlh.nlmsg_len, 0) == -1) {
+		return 1;
+	}
+
+	for (;;) {
+		len = recv(wifi->fd, buffer, sizeof(buffer), 0);
+		if (len == -1 && errno == EINTR) {
+			continue;
+		}
+		if (len <= 0) {
+			return 1;
+		}
+
+		for (msg = (struct nlmsghdr *)buffer; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+			// left over from an earlier request that failed half way
+			if (msg->nlmsg_seq != wifi->seq) {
+				continue;
+			}
+
+			if (msg->nlmsg_type == NLMSG_DONE) {
+				return 0;
+			}
+
+			if (msg->nlmsg_type == NLMSG_ERROR) {
+				err = NLMSG_DATA(msg);
+				return err->error != 0;
+			}
+
+			genl = NLMSG_DATA(msg);
+			parse_attrs(attrs, WIFI_ATTR_MAX, (char *)genl + GENL_HDRLEN,
+					msg->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN));
+			handler(attrs, data);
+		}
+	}
+}
+
+struct family_reply {
+	uint16_t id;
+	uint32_t mlme;
+};
+
+static void family_handler(struct nlattr **attrs, void *data) {
+	struct family_reply *reply = data;
+	struct nlattr *group[CTRL_ATTR_MCAST_GRP_MAX + 1];
+	struct nlattr *entry;
+	int len;
+
+	if (attrs[CTRL_ATTR_FAMILY_ID]) {
+		reply->id = *(uint16_t *)attr_data(attrs[CTRL_ATTR_FAMILY_ID]);
+	}
+
+	if (!attrs[CTRL_ATTR_MCAST_GROUPS]) {
+		return;
+	}
+
+	// an array of nested name & id pairs
+	entry = attr_data(attrs[CTRL_ATTR_MCAST_GROUPS]);
+	len = attr_len(attrs[CTRL_ATTR_MCAST_GROUPS]);
+	while (len >= NLA_HDRLEN && entry->nla_len >= NLA_HDRLEN && entry->nla_len <= len) {
+		parse_attrs(group, CTRL_ATTR_MCAST_GRP_MAX, attr_data(entry), attr_len(entry));
+		if (group[CTRL_ATTR_MCAST_GRP_NAME] && group[CTRL_ATTR_MCAST_GRP_ID]
+				&& strcmp(attr_data(group[CTRL_ATTR_MCAST_GRP_NAME]), NL80211_MULTICAST_GROUP_MLME) == 0) {
+			reply->mlme = *(uint32_t *)attr_data(group[CTRL_ATTR_MCAST_GRP_ID]);
+		}
+
+		len -= NLA_ALIGN(entry->nla_len);
+		entry = (struct nlattr *)((char *)entry + NLA_ALIGN(entry->nla_len));
+	}
+}
+
+int wifi_open(struct wifi *wifi) {
+	struct wifi_request request;
+	struct family_reply reply = { 0 };
+
+	wifi->seq = 0;
+	wifi->family = 0;
+	wifi->event_fd = -1;
+
+	if ((wifi->fd = netlink_open(NETLINK_GENERIC)) == -1) {
+		return 1;
+	}
+
+	request_init(&request, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 0);
+	request_put(&request, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME, sizeof(NL80211_GENL_NAME));
+	if (wifi_transact(wifi, &request, family_handler, &reply) || !reply.id) {
+		wifi_close(wifi);
+		return 1;
+	}
+	wifi->family = reply.id;
+
+	// without events the network is still refreshed on link changes
+	if (reply.mlme && (wifi->event_fd = netlink_open(NETLINK_GENERIC)) != -1) {
+		if (setsockopt(wifi->event_fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+				&reply.mlme, sizeof(reply.mlme)) == -1) {
+			close(wifi->event_fd);
+			wifi->event_fd = -1;
+		}
+	}
+
+	return 0;
+}
+
+void wifi_close(struct wifi *wifi) {
+	if (wifi->fd != -1) {
+		close(wifi->fd);
+	}
+	if (wifi->event_fd != -1) {
+		close(wifi->event_fd);
+	}
+
+	wifi->fd = -1;
+	wifi->event_fd = -1;
+	wifi->family = 0;
+}
+
+struct interface_reply {
+	int found;
+	char ssid[IW_ESSID_MAX_SIZE + 1];
+};
+
+static void interface_handler(struct nlattr **attrs, void *data) {
+	struct interface_reply *reply = data;
+	int len;
+
+	if (!attrs[NL80211_ATTR_IFINDEX]) {
+		return;
+	}
+
+	reply->found = 1;
+
+	// only present while associated
+	if (attrs[NL80211_ATTR_SSID]) {
+		len = attr_len(attrs[NL80211_ATTR_SSID]);
+		if (len > IW_ESSID_MAX_SIZE) {
+			len = IW_ESSID_MAX_SIZE;
+		}
+		memcpy(reply->ssid, attr_data(attrs[NL80211_ATTR_SSID]), len);
+		reply->ssid[len] = '\0';
+	}
+}
+
+static int get_interface(struct wifi *wifi, unsigned int ifindex, struct interface_reply *reply) {
+	struct wifi_request request;
+	uint32_t index = ifindex;
+
+	memset(reply, 0, sizeof(*reply));
+	if (!wifi->family) {
+		return 1;
+	}
+
+	request_init(&request, wifi->family, NL80211_CMD_GET_INTERFACE, 0);
+	request_put(&request, NL80211_ATTR_IFINDEX, &index, sizeof(index));
+
+	return wifi_transact(wifi, &request, interface_handler, reply) || !reply->found;
+}
+
+int wifi_is_wireless(struct wifi *wifi, unsigned int ifindex) {
+	struct interface_reply reply;
+	return get_interface(wifi, ifindex, &reply) == 0;
+}
+
+struct station_reply {
+	int found;
+	int signal;
+};
+
+static void station_handler(struct nlattr **attrs, void *data) {
+	struct station_reply *reply = data;
+	struct nlattr *info[NL80211_STA_INFO_MAX + 1];
+
+	if (!attrs[NL80211_ATTR_STA_INFO]) {
+		return;
+	}
+
+	parse_attrs(info, NL80211_STA_INFO_MAX,
+			attr_data(attrs[NL80211_ATTR_STA_INFO]), attr_len(attrs[NL80211_ATTR_STA_INFO]));
+
+	// a managed interface has a single station, the access point
+	reply->found = 1;
+
+	if (info[NL80211_STA_INFO_SIGNAL]) {
+		reply->signal = *(int8_t *)attr_data(info[NL80211_STA_INFO_SIGNAL]);
+	}
+}
+
+int wifi_query(struct wifi *wifi, unsigned int ifindex, struct network_info *info) {
+	struct wifi_request request;
+	struct interface_reply interface;
+	struct station_reply station = { 0 };
+	uint32_t index = ifindex;
+	int quality;
+
+	if (get_interface(wifi, ifindex, &interface) || !interface.ssid[0]) {
+		return 1;
+	}
+
+	request_init(&request, wifi->family, NL80211_CMD_GET_STATION, NLM_F_DUMP);
+	request_put(&request, NL80211_ATTR_IFINDEX, &index, sizeof(index));
+	if (wifi_transact(wifi, &request, station_handler, &station) || !station.found) {
+		return 1;
+	}
+
+	// -100 dBm is unusable, -50 dBm is as good as it gets
+	quality = 2 * (station.signal + 100);
+	if (quality < 0) {
+		quality = 0;
+	} else if (quality > 100) {
+		quality = 100;
+	}
+
+	info->type = Wireless;
+	memcpy(info->name, interface.ssid, sizeof(info->name));
+	info->quality = quality;
+
+	return 0;
+}
+
+int wifi_event_in(struct wifi *wifi) {
+	char buffer[WIFI_BUFSIZ];
+	struct nlmsghdr *msg;
+	struct genlmsghdr *genl;
+	ssize_t len;
+	int changed = 0;
+
+	while ((len = recv(wifi->event_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+		for (msg = (struct nlmsghdr *)buffer; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+			if (msg->nlmsg_type != wifi->family) {
+				continue;
+			}
+
+			genl = NLMSG_DATA(msg);
+			switch (genl->cmd) {
+			case NL80211_CMD_CONNECT:
+			case NL80211_CMD_DISCONNECT:
+			case NL80211_CMD_ROAM:
+			case NL80211_CMD_ASSOCIATE:
+			case NL80211_CMD_DISASSOCIATE:
+			case NL80211_CMD_DEAUTHENTICATE:
+				changed = 1;
+				break;
+			}
+		}
+	}
+
+	// the socket overflowed, something changed but we don't know what
+	if (len == -1 && errno == ENOBUFS) {
+		changed = 1;
+	}
+
+	return changed;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "stext.h"
+
+// A minimal nl80211 client. Station info is requested over one
+// persistent generic netlink socket, association changes arrive as
+// multicast events on a second one, see wifi_event_in().
+struct wifi {
+	// requests & their replies
+	int fd;
+	// subscribed to the "mlme" multicast group
+	int event_fd;
+	// generic netlink family id of nl80211
+	uint16_t family;
+	uint32_t seq;
+};
+
+// returns 0 on success, nl80211 isn't available otherwise
+int wifi_open(struct wifi *wifi);
+
+void wifi_close(struct wifi *wifi);
+
+// returns 1 if the interface is a wireless one
+int wifi_is_wireless(struct wifi *wifi, unsigned int ifindex);
+
+// fills in the ssid & quality of the network the interface is
+// associated with. returns 0 if it is associated
+int wifi_query(struct wifi *wifi, unsigned int ifindex, struct network_info *info);
+
+// drains event_fd, returns 1 if an association changed
+int wifi_event_in(struct wifi *wifi);